@@ -0,0 +1,464 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#ifndef GODBOLT_COMPATIBLE
+#pragma once
+#include "concepts.hpp"
+#include "async_mutex.hpp"
+#endif // GODBOLT_COMPATIBLE
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// Bounded multi-producer multi-consumer queue (D. Vyukov), used as the fast
+// path of async_channel; never blocks and never allocates after construction.
+// Holds at most capacity elements, that must be positive.
+template<typename T>
+class mpmc_ring_buffer
+{
+public:
+   explicit mpmc_ring_buffer(std::size_t capacity)
+     : capacity(capacity), mask(cell_count(capacity) - 1), cells(std::make_unique<cell[]>(mask + 1))
+   {
+      for (std::size_t i = 0; i <= mask; ++i)
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+   }
+
+   mpmc_ring_buffer(mpmc_ring_buffer&&) = delete;
+
+   // Moves from value only if it was stored.
+   bool try_push(T& value)
+   {
+      cell* c;
+      std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+      while (true)
+      {
+         c = &cells[pos & mask];
+         std::size_t seq = c->sequence.load(std::memory_order_acquire);
+         auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+         if (diff == 0)
+         {
+            // the cell is free, but the capacity may be lower than the number of cells
+            if (capacity <= mask)
+            {
+               auto used = static_cast<std::intptr_t>(pos) - static_cast<std::intptr_t>(dequeue_pos.load(std::memory_order_relaxed));
+               if (used >= static_cast<std::intptr_t>(capacity))
+                 return false;
+            }
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+              break;
+         }
+         else if (diff < 0)
+           return false;
+         else
+           pos = enqueue_pos.load(std::memory_order_relaxed);
+      }
+
+      c->value.emplace(std::move(value));
+      c->sequence.store(pos + 1, std::memory_order_release);
+      return true;
+   }
+
+   bool try_pop(std::optional<T>& out)
+   {
+      cell* c;
+      std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+      while (true)
+      {
+         c = &cells[pos & mask];
+         std::size_t seq = c->sequence.load(std::memory_order_acquire);
+         auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+         if (diff == 0)
+         {
+            if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+              break;
+         }
+         else if (diff < 0)
+           return false;
+         else
+           pos = dequeue_pos.load(std::memory_order_relaxed);
+      }
+
+      out.emplace(std::move(*c->value));
+      c->value.reset();
+      c->sequence.store(pos + mask + 1, std::memory_order_release);
+      return true;
+   }
+
+private:
+   // Power of two, and at least two: in a single cell, the sequence of the
+   // popped value equals the one expected by the next push, so a push would
+   // overwrite a value that was not popped yet.
+   static std::size_t cell_count(std::size_t capacity)
+   {
+      if (capacity == 0)
+        std::terminate();
+
+      std::size_t result = 2;
+      while (result < capacity)
+        result <<= 1;
+      return result;
+   }
+
+   struct cell
+   {
+      std::atomic<std::size_t> sequence;
+      std::optional<T> value;
+   };
+
+   std::size_t capacity;
+   std::size_t mask;
+   std::unique_ptr<cell[]> cells;
+   alignas(64) std::atomic<std::size_t> enqueue_pos{0};
+   alignas(64) std::atomic<std::size_t> dequeue_pos{0};
+};
+
+// FIFO of intrusive waiters, protected by the channel mutex.
+struct waiter_list
+{
+   handle_base* head = nullptr;
+   handle_base* tail = nullptr;
+
+   bool empty() const
+   {
+      return head == nullptr;
+   }
+
+   void push_back(handle_base* op)
+   {
+      op->next = nullptr;
+      op->prev = tail;
+      if (tail)
+        tail->next = op;
+      else
+        head = op;
+      tail = op;
+   }
+
+   handle_base* pop_front()
+   {
+      handle_base* op = head;
+      head = op->next;
+      if (head)
+        head->prev = nullptr;
+      else
+        tail = nullptr;
+      op->next = op->prev = nullptr;
+      return op;
+   }
+};
+
+// Channel of at most capacity elements of type T; the capacity must be
+// positive.
+//
+// send(value) completes with set_value() once the value is stored, and
+// receive() completes with set_value(T) once a value is available; both
+// suspend as intrusive waiters instead of blocking the thread. After close()
+// pending and new send() complete with set_done(), while receive() continues
+// to deliver the stored values and then completes with set_done().
+template<typename T>
+class async_channel
+{
+   struct send_waiter : handle_base
+   {
+      explicit send_waiter(T&& v) : value(std::move(v))
+      {}
+
+      T value;
+      bool closed = false;
+   };
+
+   struct receive_waiter : handle_base
+   {
+      std::optional<T> value;
+   };
+
+public:
+   struct send_sender;
+   struct receive_sender;
+
+   explicit async_channel(std::size_t capacity)
+     : ring(capacity)
+   {}
+
+   async_channel(async_channel&&) = delete;
+
+   send_sender send(T value)
+   {
+      return send_sender{this, std::move(value)};
+   }
+
+   receive_sender receive()
+   {
+      return receive_sender{this};
+   }
+
+   void close()
+   {
+      closed.store(true, std::memory_order_seq_cst);
+      pump();
+   }
+
+   bool is_closed() const
+   {
+      return closed.load(std::memory_order_acquire);
+   }
+
+private:
+   // Returns true if value was stored, otherwise waiter was enqueued or
+   // marked as closed.
+   bool send_or_enqueue(send_waiter* op)
+   {
+      if (ring.try_push(op->value))
+      {
+         wake_receivers();
+         return true;
+      }
+
+      std::unique_lock<std::mutex> lock(m);
+      // pairs with the read-modify-write in wake_senders(): if it read the
+      // count before this increment, this one reads from it, and the
+      // retry below sees the cell it freed
+      waiting_senders.fetch_add(1, std::memory_order_seq_cst);
+      if (ring.try_push(op->value))
+      {
+         waiting_senders.fetch_sub(1, std::memory_order_relaxed);
+         lock.unlock();
+         wake_receivers();
+         return true;
+      }
+
+      if (closed.load(std::memory_order_seq_cst))
+      {
+         waiting_senders.fetch_sub(1, std::memory_order_relaxed);
+         op->closed = true;
+         return true;
+      }
+
+      senders.push_back(op);
+      return false;
+   }
+
+   // Returns true if the waiter received a value or the channel is closed.
+   bool receive_or_enqueue(receive_waiter* op)
+   {
+      if (ring.try_pop(op->value))
+      {
+         wake_senders();
+         return true;
+      }
+
+      std::unique_lock<std::mutex> lock(m);
+      // pairs with the read-modify-write in wake_receivers(): if it read the
+      // count before this increment, this one reads from it, and the
+      // retry below sees the value it stored
+      waiting_receivers.fetch_add(1, std::memory_order_seq_cst);
+      if (ring.try_pop(op->value))
+      {
+         waiting_receivers.fetch_sub(1, std::memory_order_relaxed);
+         lock.unlock();
+         wake_senders();
+         return true;
+      }
+
+      if (closed.load(std::memory_order_seq_cst))
+      {
+         waiting_receivers.fetch_sub(1, std::memory_order_relaxed);
+         return true;
+      }
+
+      receivers.push_back(op);
+      return false;
+   }
+
+   void wake_receivers()
+   {
+      // a read-modify-write, unlike a load, is ordered with the increment
+      // of the waiters (see send_or_enqueue and receive_or_enqueue)
+      if (waiting_receivers.fetch_add(0, std::memory_order_seq_cst) != 0)
+        pump();
+   }
+
+   void wake_senders()
+   {
+      // see wake_receivers()
+      if (waiting_senders.fetch_add(0, std::memory_order_seq_cst) != 0)
+        pump();
+   }
+
+   // Matches waiting receivers with stored values and waiting senders with
+   // free slots, the completed waiters are resumed after the lock is released.
+   void pump()
+   {
+      waiter_list ready;
+      {
+        std::lock_guard<std::mutex> lock(m);
+        bool progress = true;
+        while (progress)
+        {
+           progress = false;
+           while (!receivers.empty()
+                  && ring.try_pop(static_cast<receive_waiter*>(receivers.head)->value))
+           {
+              waiting_receivers.fetch_sub(1, std::memory_order_relaxed);
+              ready.push_back(receivers.pop_front());
+           }
+
+           while (!senders.empty()
+                  && ring.try_push(static_cast<send_waiter*>(senders.head)->value))
+           {
+              waiting_senders.fetch_sub(1, std::memory_order_relaxed);
+              ready.push_back(senders.pop_front());
+              progress = true;
+           }
+        }
+
+        if (closed.load(std::memory_order_seq_cst))
+        {
+           while (!senders.empty())
+           {
+              waiting_senders.fetch_sub(1, std::memory_order_relaxed);
+              static_cast<send_waiter*>(senders.head)->closed = true;
+              ready.push_back(senders.pop_front());
+           }
+
+           while (!receivers.empty())
+           {
+              waiting_receivers.fetch_sub(1, std::memory_order_relaxed);
+              ready.push_back(receivers.pop_front());
+           }
+        }
+      }
+
+      while (!ready.empty())
+        std::move(*ready.pop_front()).run();
+   }
+
+   mpmc_ring_buffer<T> ring;
+   std::atomic<bool> closed{false};
+   std::atomic<std::size_t> waiting_senders{0};
+   std::atomic<std::size_t> waiting_receivers{0};
+
+   std::mutex m;
+   waiter_list senders;
+   waiter_list receivers;
+};
+
+template<typename T>
+struct async_channel<T>::send_sender
+{
+   template<template<class...> class Tuple, template<class...> class Variant>
+     using value_types = Variant<Tuple<>>;
+   template<template<class...> class Variant>
+     using error_types = set_value_error_types<Variant>;
+   static constexpr bool sends_done = true;
+
+   async_channel* channel;
+   T value;
+
+   template<typename Receiver>
+     requires receiver_of<Receiver>
+   friend auto connect(send_sender s, Receiver&& r)
+   {
+      struct operation_type : send_waiter
+      {
+         async_channel* channel;
+         std::remove_cvref_t<Receiver> r;
+
+         explicit operation_type(send_sender&& s, Receiver&& r)
+           : send_waiter(std::move(s.value)), channel(s.channel), r(std::forward<Receiver>(r))
+         {}
+
+         operation_type(operation_type&&) = delete;
+
+         void start() &&
+         {
+            if (channel->is_closed())
+              return std::move(r).set_done();
+
+            if (enqueue(channel, this))
+              std::move(*this).run();
+         }
+
+         void run() && override
+         {
+            if (this->closed)
+              return std::move(r).set_done();
+
+            set_value_or_error(std::move(r));
+         }
+      };
+
+      return operation_type(std::move(s), std::forward<Receiver>(r));
+   }
+
+private:
+   static bool enqueue(async_channel* channel, send_waiter* op)
+   {
+      return channel->send_or_enqueue(op);
+   }
+};
+
+template<typename T>
+struct async_channel<T>::receive_sender
+{
+   template<template<class...> class Tuple, template<class...> class Variant>
+     using value_types = Variant<Tuple<T>>;
+   template<template<class...> class Variant>
+     using error_types = set_value_error_types<Variant>;
+   static constexpr bool sends_done = true;
+
+   async_channel* channel;
+
+   template<typename Receiver>
+     requires receiver_of<Receiver, T>
+   friend auto connect(receive_sender s, Receiver&& r)
+   {
+      struct operation_type : receive_waiter
+      {
+         async_channel* channel;
+         std::remove_cvref_t<Receiver> r;
+
+         explicit operation_type(receive_sender&& s, Receiver&& r)
+           : channel(s.channel), r(std::forward<Receiver>(r))
+         {}
+
+         operation_type(operation_type&&) = delete;
+
+         void start() &&
+         {
+            if (enqueue(channel, this))
+              std::move(*this).run();
+         }
+
+         void run() && override
+         {
+            if (!this->value)
+              return std::move(r).set_done();
+
+            set_value_or_error(std::move(r), std::move(*this->value));
+         }
+      };
+
+      return operation_type(std::move(s), std::forward<Receiver>(r));
+   }
+private:
+   static bool enqueue(async_channel* channel, receive_waiter* op)
+   {
+      return channel->receive_or_enqueue(op);
+   }
+};
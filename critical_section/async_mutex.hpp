@@ -10,18 +10,27 @@
 
 #ifndef GODBOLT_COMPATIBLE
 #pragma once
+#include "instrumentation.hpp"
 #endif // GODBOLT_COMPATIBLE
 
+#include <atomic>
+#include <cstdint>
+#include <exception>
 #include <mutex>
+#include <thread>
 
 struct handle_base
 {
     handle_base* prev = nullptr;
     handle_base* next = nullptr;
+    [[no_unique_address]] handle_trace trace;
     
     virtual void run() && = 0;
 };
 
+// Mutex acquired asynchronously by locked(), or by blocking lock() and
+// unlock(), so it also meets the Lockable requirements. Both kinds of
+// waiters are granted the lock in the FIFO order of a single queue.
 class async_mutex
 {
 public:
@@ -32,37 +41,149 @@ public:
     
    bool enqueue(handle_base* op)
    {
-      std::lock_guard<std::mutex> lock(m);
-      if (head == nullptr)
+      instr.enqueued(op->trace);
       {
-          head = tail = op;
-          return true;
+         std::lock_guard<std::mutex> lock(m);
+         if (head != nullptr)
+         {
+            tail->next = op;
+            op->prev = tail;
+            tail = op;
+            return false;
+         }
+         head = tail = op;
       }
-      
-      tail->next = op;
-      op->prev = tail;
-      tail = op;
-      return false;
+      instr.granted(nullptr, op->trace);
+      return true;
    }
     
    handle_base* deque(handle_base* op)
    {
-       std::lock_guard<std::mutex> lock(m);
+       bool owner;
+       handle_base* next;
        {
-         auto& prevNext = (head == op) ? head : op->prev->next;
-         prevNext = op->next;
-       }
+         std::lock_guard<std::mutex> lock(m);
+         owner = (head == op);
+
+         {
+           auto& prevNext = (head == op) ? head : op->prev->next;
+           prevNext = op->next;
+         }
        
+         {
+           auto& nextPrev = (tail == op) ? tail : op->next->prev;
+           nextPrev = op->prev;
+         }
+         next = head;
+       }
+
+       // the caller owns op, and resumes next only after the return
+       if (owner)
+       {
+         instr.released(this, op->trace);
+         if (next)
+           instr.granted(this, next->trace);
+       }
+       return next;
+   }
+
+   // Blocks the calling thread until the lock is granted.
+   void lock()
+   {
+       blocking_waiter waiter;
+       if (!enqueue(&waiter))
+         waiter.wait();
+       replace_owner(&waiter);
+   }
+
+   bool try_lock()
+   {
        {
-         auto& nextPrev = (tail == op) ? tail : op->next->prev;
-         nextPrev = op->prev;
+         std::lock_guard<std::mutex> lock(m);
+         if (head != nullptr)
+           return false;
+
+         owner.prev = owner.next = nullptr;
+         head = tail = &owner;
        }
+       instr.enqueued(owner.trace);
+       instr.granted(nullptr, owner.trace);
+       return true;
+   }
 
-       return head;
+   // Releases the lock acquired by lock() or try_lock(), and hands it over
+   // to the next waiter.
+   void unlock()
+   {
+       handle_base* next = deque(&owner);
+       if (next)
+         std::move(*next).run();
+   }
+
+   mutex_instrumentation const& instrumentation() const
+   {
+       return instr;
    }
 
 private:
+   // Placeholder for the thread holding the lock acquired by lock(),
+   // the head of the queue is never run.
+   struct owner_handle : handle_base
+   {
+       void run() && override
+       {
+           std::terminate();
+       }
+   };
+
+   // Waiter of lock(), living on the stack of the blocked thread, that
+   // sleeps on its own state, so only the granted thread is woken. The
+   // granting thread notifies before the final store, and the waiter does
+   // not return until it sees that store, so the waiter is not touched
+   // after it may be destroyed.
+   struct blocking_waiter : handle_base
+   {
+       enum : std::uint32_t { waiting, notified, granted };
+       std::atomic<std::uint32_t> state{waiting};
+
+       void run() && override
+       {
+           state.store(notified, std::memory_order_relaxed);
+           state.notify_one();
+           state.store(granted, std::memory_order_release);
+       }
+
+       void wait()
+       {
+           std::uint32_t current;
+           while ((current = state.load(std::memory_order_acquire)) == waiting)
+             state.wait(waiting, std::memory_order_acquire);
+           // the granting thread is between notify_one() and the final store
+           while (current != granted)
+           {
+               std::this_thread::yield();
+               current = state.load(std::memory_order_acquire);
+           }
+       }
+   };
+
+   // Replaces the waiter at the head of the queue with the owner handle.
+   void replace_owner(handle_base* waiter)
+   {
+       std::lock_guard<std::mutex> lock(m);
+       owner.trace = waiter->trace;
+       owner.prev = nullptr;
+       owner.next = waiter->next;
+       head = &owner;
+       if (tail == waiter)
+         tail = &owner;
+       else
+         owner.next->prev = &owner;
+   }
+
    std::mutex m; 
    handle_base* head;
    handle_base* tail;
+   owner_handle owner;
+   [[no_unique_address]] mutex_instrumentation instr;
 };
@@ -0,0 +1,86 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "async_channel.hpp"
+#include "started_operation.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct count_receiver
+{
+   std::size_t* count;
+   bool* closed;
+
+   void set_value(int) && noexcept
+   {
+      ++*count;
+   }
+
+   void set_value() && noexcept
+   {}
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {}
+
+   void set_done() && noexcept
+   {
+      *closed = true;
+   }
+};
+
+// Values transferred by the given number of sending and receiving threads,
+// through a channel of the given capacity; each thread waits for the
+// completion of its operation before starting the next one.
+void channel_transfer(benchmark::State& state)
+{
+   constexpr std::size_t per_thread = 20000;
+   auto threads = static_cast<std::size_t>(state.range(0));
+   auto capacity = static_cast<std::size_t>(state.range(1));
+
+   for (auto _ : state)
+   {
+      async_channel<int> ch(capacity);
+      std::vector<std::jthread> receivers;
+      for (std::size_t t = 0; t < threads; ++t)
+        receivers.emplace_back([&] {
+           std::size_t count = 0;
+           bool closed = false;
+           while (!closed)
+             sync_wait(ch.receive(), count_receiver{&count, &closed});
+           benchmark::DoNotOptimize(count);
+        });
+
+      {
+         std::vector<std::jthread> senders;
+         for (std::size_t t = 0; t < threads; ++t)
+           senders.emplace_back([&] {
+              std::size_t unused = 0;
+              bool closed = false;
+              for (std::size_t i = 0; i < per_thread; ++i)
+                sync_wait(ch.send(static_cast<int>(i)), count_receiver{&unused, &closed});
+           });
+      }
+      ch.close();
+   }
+   state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * threads * per_thread));
+}
+BENCHMARK(channel_transfer)
+  ->ArgNames({"threads", "capacity"})
+  ->ArgsProduct({{1, 4, 16}, {1, 64}})
+  ->UseRealTime();
+
+} // namespace
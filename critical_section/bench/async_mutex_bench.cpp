@@ -0,0 +1,128 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "async_mutex.hpp"
+#include "locked_sender.hpp"
+#include "helpers.hpp"
+#include "thread_pool.hpp"
+#include "started_operation.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdint>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+struct latch_receiver
+{
+   std::latch* latch;
+
+   template<typename... Args>
+   void set_value(Args&&...) && noexcept
+   {
+      latch->count_down();
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {}
+
+   void set_done() && noexcept
+   {}
+};
+
+// Blocking lock() and unlock() by contending threads, compared with std::mutex.
+template<typename Mutex>
+void blocking_lock(benchmark::State& state)
+{
+   static Mutex m;
+   static long counter = 0;
+   for (auto _ : state)
+   {
+      std::lock_guard<Mutex> lock(m);
+      ++counter;
+   }
+   state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(blocking_lock, async_mutex)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(blocking_lock, std::mutex)->ThreadRange(1, 8)->UseRealTime();
+
+// Blocking users (Arg threads) and a batch of locked() operations on the
+// pool; the blocking users run until the batch completes. With async_mutex
+// they contend for the same mutex, otherwise the blocking users update
+// a separate counter under a BlockingMutex, as the baseline.
+template<typename BlockingMutex>
+void mixed_mode_lock(benchmark::State& state)
+{
+   constexpr std::size_t batch = 10000;
+   constexpr bool shared = std::is_same_v<BlockingMutex, async_mutex>;
+   auto blocking_threads = static_cast<std::size_t>(state.range(0));
+   thread_pool pool(2);
+   async_mutex m;
+   long counter = 0;
+   auto work = [&](auto s) { return then(std::move(s), [&] { return ++counter; }); };
+
+   BlockingMutex separate_mutex;
+   long separate_counter = 0;
+   BlockingMutex& blocking_mutex = [&]() -> BlockingMutex& {
+      if constexpr (shared)
+        return m;
+      else
+        return separate_mutex;
+   }();
+   long& blocking_counter = shared ? counter : separate_counter;
+
+   std::vector<std::shared_ptr<void>> ops;
+   ops.reserve(batch);
+   std::int64_t blocking_sections = 0;
+   for (auto _ : state)
+   {
+      std::atomic<bool> stop{false};
+      std::atomic<std::int64_t> sections{0};
+      std::vector<std::jthread> users;
+      for (std::size_t t = 0; t < blocking_threads; ++t)
+        users.emplace_back([&] {
+           std::int64_t local = 0;
+           while (!stop.load(std::memory_order_relaxed))
+           {
+              std::lock_guard<BlockingMutex> lock(blocking_mutex);
+              ++blocking_counter;
+              ++local;
+           }
+           sections.fetch_add(local, std::memory_order_relaxed);
+        });
+
+      std::latch latch(batch);
+      for (std::size_t i = 0; i < batch; ++i)
+        ops.push_back(start_operation(locked(pool.scheduler().schedule(), work, m), latch_receiver{&latch}));
+      latch.wait();
+      stop = true;
+      users.clear();
+      blocking_sections += sections.load();
+
+      state.PauseTiming();
+      ops.clear();
+      state.ResumeTiming();
+   }
+   state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * batch) + blocking_sections);
+   state.counters["blocking_sections"] = benchmark::Counter(
+     static_cast<double>(blocking_sections), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK_TEMPLATE(mixed_mode_lock, async_mutex)->Arg(0)->Arg(1)->Arg(4)->UseRealTime();
+BENCHMARK_TEMPLATE(mixed_mode_lock, std::mutex)->Arg(0)->Arg(1)->Arg(4)->UseRealTime();
+
+} // namespace
@@ -0,0 +1,191 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "capture_sender.hpp"
+#include "resume_via_sender.hpp"
+#include "helpers.hpp"
+#include "started_operation.hpp"
+#include "thread_pool.hpp"
+#include "allocation_counter.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <exception>
+#include <latch>
+#include <memory>
+#include <vector>
+
+namespace {
+
+using just10_result = received_result_t<just10_sender>;
+
+struct sum_visitor
+{
+   long* sum;
+
+   void operator()(received_values<int>& v) noexcept
+   {
+      *sum += std::get<0>(v.value);
+   }
+
+   void operator()(received_error<std::exception_ptr>&) noexcept
+   {}
+};
+
+struct stored_result_receiver
+{
+   long* sum;
+
+   void set_value(just10_result& res) && noexcept
+   {
+      res.visit(sum_visitor{sum});
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {}
+
+   void set_done() && noexcept
+   {}
+};
+
+// Connecting capture_args(), storing the value and visiting the stored result.
+void capture_args_value(benchmark::State& state)
+{
+   long sum = 0;
+   for (auto _ : state)
+   {
+      started_operation op(capture_args(just10_sender{}), stored_result_receiver{&sum});
+      benchmark::DoNotOptimize(sum);
+   }
+   state.counters["operation_bytes"] = static_cast<double>(
+     sizeof(operation_state_type<capture_sender<just10_sender>, stored_result_receiver>));
+}
+BENCHMARK(capture_args_value);
+
+struct value_receiver
+{
+   long* sum;
+
+   void set_value(int v) && noexcept
+   {
+      *sum += v;
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {}
+
+   void set_done() && noexcept
+   {}
+};
+
+// Inline scheduler that is not recognized as one, so resume_via() connects
+// and starts the schedule sender.
+struct opaque_inline_scheduler
+{
+   inline_sender schedule()
+   {
+      return {};
+   }
+};
+
+// Delivers the stored result through resume_via() on the scheduler.
+template<typename Scheduler>
+void resume_via_stored_value(benchmark::State& state)
+{
+   long sum = 0;
+   just10_result stored;
+   stored.emplace<received_values<int>>(10);
+   for (auto _ : state)
+   {
+      started_operation op(resume_via(Scheduler{}, stored), value_receiver{&sum});
+      benchmark::DoNotOptimize(sum);
+   }
+   state.counters["operation_bytes"] = static_cast<double>(
+     sizeof(operation_state_type<resume_via_sender<Scheduler, just10_result>, value_receiver>));
+}
+BENCHMARK_TEMPLATE(resume_via_stored_value, inline_scheduler);
+BENCHMARK_TEMPLATE(resume_via_stored_value, opaque_inline_scheduler);
+
+struct blocking_receiver
+{
+   std::latch* released;
+
+   void set_value() && noexcept
+   {
+      released->wait();
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {}
+
+   void set_done() && noexcept
+   {}
+};
+
+struct counting_result_receiver
+{
+   std::latch* latch;
+
+   template<typename Result>
+   void set_value(Result&) && noexcept
+   {
+      latch->count_down();
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {}
+
+   void set_done() && noexcept
+   {}
+};
+
+// Footprint of a million capture_args() operations on the thread pool, that
+// are all pending at once, as the only worker is blocked until they are
+// started. The heap bytes are requested from the operator new per operation,
+// mostly by start_operation(); the queued tasks reuse the blocks that
+// pool_allocator kept from the earlier iterations.
+void capture_args_pending_on_pool(benchmark::State& state)
+{
+   constexpr std::size_t count = 1'000'000;
+   using operation = operation_state_type<capture_sender<thread_pool::sender_type>, counting_result_receiver>;
+
+   // destroyed after the pool is joined, as the receiver may still be
+   // returning from count_down() on the worker
+   std::vector<std::shared_ptr<void>> ops;
+   ops.reserve(count);
+   thread_pool pool(1);
+   std::size_t bytes = 0;
+   for (auto _ : state)
+   {
+      std::latch released(1);
+      std::latch completed(count);
+      submit(pool.scheduler().schedule(), blocking_receiver{&released});
+
+      std::size_t before = allocated_bytes();
+      for (std::size_t i = 0; i < count; ++i)
+        ops.push_back(start_operation(capture_args(pool.scheduler().schedule()), counting_result_receiver{&completed}));
+      bytes += allocated_bytes() - before;
+
+      released.count_down();
+      completed.wait();
+      ops.clear();
+   }
+   state.counters["operation_bytes"] = static_cast<double>(sizeof(operation));
+   state.counters["heap_bytes"] = benchmark::Counter(
+     static_cast<double>(bytes) / count, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(capture_args_pending_on_pool)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // namespace
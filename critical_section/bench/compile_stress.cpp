@@ -0,0 +1,91 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+// Translation unit compiled by the compile_time_critical_section_bench
+// target, to measure the cost of instantiating sender chains; it is not
+// run. Each of the COMPILE_STRESS_CHAINS chains has distinct types, built
+// from then() and locked() (that captures the arguments and resumes them),
+// and from capture_args() and resume_via() directly.
+#include "capture_sender.hpp"
+#include "helpers.hpp"
+#include "locked_sender.hpp"
+#include "resume_via_sender.hpp"
+#include "started_operation.hpp"
+#include "thread_pool.hpp"
+
+#include <array>
+#include <utility>
+
+#ifndef COMPILE_STRESS_CHAINS
+#define COMPILE_STRESS_CHAINS 16
+#endif
+
+namespace {
+
+struct sink_receiver
+{
+   template<typename... Args>
+   void set_value(Args&&...) && noexcept
+   {}
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {}
+
+   void set_done() && noexcept
+   {}
+};
+
+// Resumes the captured result of the chain on the pool.
+struct resume_receiver
+{
+   thread_pool* pool;
+
+   template<typename Result>
+   void set_value(Result& result) &&
+   {
+      started_operation op(resume_via(pool->scheduler(), result), sink_receiver{});
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {}
+
+   void set_done() && noexcept
+   {}
+};
+
+template<int I>
+auto make_chain(thread_pool& pool, async_mutex& m)
+{
+   auto step = [](int v) { return v + I; };
+   auto work = [step](auto s) { return then(then(std::move(s), step), step); };
+   auto first = then(pool.scheduler().schedule(), [] { return I; });
+   return then(locked(std::move(first), work, m), step);
+}
+
+template<int I>
+void start_chain(thread_pool& pool, async_mutex& m)
+{
+   started_operation locking(make_chain<I>(pool, m), sink_receiver{});
+   started_operation resuming(capture_args(then(pool.scheduler().schedule(), [] { return I; })),
+                              resume_receiver{&pool});
+}
+
+template<int... I>
+constexpr auto chains(std::integer_sequence<int, I...>)
+{
+   return std::array{&start_chain<I>...};
+}
+
+} // namespace
+
+// referenced, so every chain is instantiated
+auto const compile_stress_chains = chains(std::make_integer_sequence<int, COMPILE_STRESS_CHAINS>());
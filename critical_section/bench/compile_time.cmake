@@ -0,0 +1,13 @@
+# Compiles the stress translation unit with -ftime-report, and writes the
+# report (time and memory of each phase, including template instantiation)
+# to OUTPUT. Run by the compile_time_critical_section_bench target.
+execute_process(
+  COMMAND ${COMPILER} ${FLAGS} -fsyntax-only -ftime-report ${SOURCE}
+  RESULT_VARIABLE result
+  ERROR_VARIABLE report)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "${report}")
+endif()
+
+file(WRITE ${OUTPUT} "${report}")
+message("${report}")
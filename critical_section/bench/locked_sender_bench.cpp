@@ -0,0 +1,149 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "locked_sender.hpp"
+#include "helpers.hpp"
+#include "thread_pool.hpp"
+#include "allocation_counter.hpp"
+#include "started_operation.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <latch>
+#include <memory>
+#include <vector>
+
+namespace {
+
+struct latch_receiver
+{
+   std::latch* latch;
+
+   template<typename... Args>
+   void set_value(Args&&...) && noexcept
+   {
+      latch->count_down();
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {}
+
+   void set_done() && noexcept
+   {}
+};
+
+struct sink_receiver
+{
+   long* sink;
+
+   void set_value(long v) && noexcept
+   {
+      *sink = v;
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {}
+
+   void set_done() && noexcept
+   {}
+};
+
+// locked() on an inline sender, with the mutex never contended.
+void locked_uncontended(benchmark::State& state)
+{
+   async_mutex m;
+   long counter = 0;
+   long sink = 0;
+   auto work = [&](auto s) { return then(std::move(s), [&] { return ++counter; }); };
+
+   std::size_t allocations = allocation_count();
+   for (auto _ : state)
+   {
+      started_operation op(locked(inline_sender{}, work, m), sink_receiver{&sink});
+      benchmark::DoNotOptimize(sink);
+   }
+   state.counters["allocations"] = benchmark::Counter(
+     static_cast<double>(allocation_count() - allocations), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(locked_uncontended);
+
+// Critical sections of locked() operations started at once on the pool, so
+// most of them are handed the lock by the previous owner.
+void locked_hand_off(benchmark::State& state)
+{
+   constexpr std::size_t batch = 10000;
+   thread_pool pool(static_cast<std::size_t>(state.range(0)));
+   async_mutex m;
+   long counter = 0;
+   auto work = [&](auto s) { return then(std::move(s), [&] { return ++counter; }); };
+
+   std::vector<std::shared_ptr<void>> ops;
+   ops.reserve(batch);
+   std::size_t allocations = 0;
+   for (auto _ : state)
+   {
+      std::latch latch(batch);
+      std::size_t before = allocation_count();
+      for (std::size_t i = 0; i < batch; ++i)
+        ops.push_back(start_operation(locked(pool.scheduler().schedule(), work, m), latch_receiver{&latch}));
+      latch.wait();
+      allocations += allocation_count() - before;
+
+      state.PauseTiming();
+      ops.clear();
+      state.ResumeTiming();
+   }
+   state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * batch));
+   // includes the allocation of the operation state by start_operation()
+   state.counters["allocations"] = benchmark::Counter(
+     static_cast<double>(allocations) / batch, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(locked_hand_off)->Arg(1)->Arg(4)->UseRealTime();
+
+// Critical sections that need two mutexes, taken by a single locked() call,
+// compared with nesting a locked() call in the work of another (Arg 1).
+void locked_two_mutexes(benchmark::State& state)
+{
+   constexpr std::size_t batch = 10000;
+   bool nested = state.range(0) != 0;
+   thread_pool pool(4);
+   async_mutex first, second;
+   long from = 0, to = 0;
+   auto work = [&](auto s) { return then(std::move(s), [&] { --from; return ++to; }); };
+   auto outer_work = [&](auto s) { return locked(std::move(s), work, second); };
+
+   std::vector<std::shared_ptr<void>> ops;
+   ops.reserve(batch);
+   for (auto _ : state)
+   {
+      std::latch latch(batch);
+      for (std::size_t i = 0; i < batch; ++i)
+      {
+         if (nested)
+           ops.push_back(start_operation(locked(pool.scheduler().schedule(), outer_work, first),
+                                         latch_receiver{&latch}));
+         else
+           ops.push_back(start_operation(locked(pool.scheduler().schedule(), work, first, second),
+                                         latch_receiver{&latch}));
+      }
+      latch.wait();
+
+      state.PauseTiming();
+      ops.clear();
+      state.ResumeTiming();
+   }
+   state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * batch));
+}
+BENCHMARK(locked_two_mutexes)->ArgName("nested")->Arg(0)->Arg(1)->UseRealTime();
+
+} // namespace
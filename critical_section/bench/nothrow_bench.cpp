@@ -0,0 +1,70 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "locked_sender.hpp"
+#include "helpers.hpp"
+#include "started_operation.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <exception>
+
+namespace {
+
+// Receivers of the same values, differing only in the noexcept of set_value,
+// that decides if set_value_or_error() installs an exception handler.
+template<bool Nothrow>
+struct sink_receiver
+{
+   long* sink;
+
+   void set_value(int v) && noexcept(Nothrow)
+   {
+      *sink += v;
+   }
+
+   void set_error(std::exception_ptr) && noexcept
+   {}
+
+   void set_done() && noexcept
+   {}
+};
+
+template<bool Nothrow>
+void nothrow_just10(benchmark::State& state)
+{
+   long sink = 0;
+   for (auto _ : state)
+   {
+      started_operation op(just10_sender{}, sink_receiver<Nothrow>{&sink});
+      benchmark::DoNotOptimize(sink);
+   }
+}
+BENCHMARK_TEMPLATE(nothrow_just10, true);
+BENCHMARK_TEMPLATE(nothrow_just10, false);
+
+// locked() with the mutex never contended, whose unlock_mutex_receiver
+// forwards the value with set_value_or_error().
+template<bool Nothrow>
+void nothrow_locked(benchmark::State& state)
+{
+   async_mutex m;
+   long sink = 0;
+   auto work = [](auto s) { return s; };
+   for (auto _ : state)
+   {
+      started_operation op(locked(just10_sender{}, work, m), sink_receiver<Nothrow>{&sink});
+      benchmark::DoNotOptimize(sink);
+   }
+}
+BENCHMARK_TEMPLATE(nothrow_locked, true);
+BENCHMARK_TEMPLATE(nothrow_locked, false);
+
+} // namespace
@@ -0,0 +1,98 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "pool_allocator.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t batch = 64;
+
+struct pool_calls
+{
+   static void* allocate(std::size_t bytes)
+   {
+      return pool_resource::allocate(bytes);
+   }
+
+   static void deallocate(void* p, std::size_t bytes) noexcept
+   {
+      pool_resource::deallocate(p, bytes);
+   }
+};
+
+struct malloc_calls
+{
+   static void* allocate(std::size_t bytes)
+   {
+      return std::malloc(bytes);
+   }
+
+   static void deallocate(void* p, std::size_t) noexcept
+   {
+      std::free(p);
+   }
+};
+
+// Allocates and frees a batch of blocks of the given size on one thread.
+template<typename Calls>
+void allocate_batch(benchmark::State& state)
+{
+   auto bytes = static_cast<std::size_t>(state.range(0));
+   std::vector<void*> blocks(batch);
+   for (auto _ : state)
+   {
+      for (void*& b : blocks)
+        b = Calls::allocate(bytes);
+      benchmark::DoNotOptimize(blocks.data());
+      for (void* b : blocks)
+        Calls::deallocate(b, bytes);
+   }
+   state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * batch));
+}
+BENCHMARK_TEMPLATE(allocate_batch, pool_calls)->Arg(16)->Arg(128)->Arg(512);
+BENCHMARK_TEMPLATE(allocate_batch, malloc_calls)->Arg(16)->Arg(128)->Arg(512);
+
+// Blocks allocated by one thread and freed by other, like the tasks of
+// thread_pool enqueued by a different thread than the worker running them.
+template<typename Calls>
+void allocate_cross_thread(benchmark::State& state)
+{
+   constexpr std::size_t rounds = 256;
+   constexpr std::size_t bytes = 128;
+   std::vector<std::vector<void*>> blocks(rounds, std::vector<void*>(batch));
+   for (auto _ : state)
+   {
+      std::thread producer([&] {
+         for (auto& round : blocks)
+           for (void*& b : round)
+             b = Calls::allocate(bytes);
+      });
+      producer.join();
+      std::thread consumer([&] {
+         for (auto& round : blocks)
+           for (void* b : round)
+             Calls::deallocate(b, bytes);
+      });
+      consumer.join();
+   }
+   state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * rounds * batch));
+}
+BENCHMARK_TEMPLATE(allocate_cross_thread, pool_calls)->UseRealTime();
+BENCHMARK_TEMPLATE(allocate_cross_thread, malloc_calls)->UseRealTime();
+
+} // namespace
@@ -0,0 +1,122 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "seqlock.hpp"
+#include "helpers.hpp"
+#include "started_operation.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace {
+
+struct sink_receiver
+{
+   long* sink;
+
+   void set_value(long v) && noexcept
+   {
+      *sink = v;
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {}
+
+   void set_done() && noexcept
+   {}
+};
+
+struct shared_data
+{
+   seqlock lock;
+   std::atomic<long> first{0};
+   std::atomic<long> second{0};
+};
+
+shared_data data;
+
+// Keeps writing the shared data with locked() while the benchmark runs;
+// started by the first thread of the benchmark, if Arg is not zero.
+struct background_writer
+{
+   std::atomic<bool> stop{false};
+   std::jthread thread;
+
+   background_writer()
+     : thread([this] {
+          auto write = [](auto s) {
+             return then(std::move(s), [] {
+                long next = data.first.load(std::memory_order_relaxed) + 1;
+                data.first.store(next, std::memory_order_relaxed);
+                data.second.store(next, std::memory_order_relaxed);
+                return next;
+             });
+          };
+          long sink = 0;
+          while (!stop.load(std::memory_order_relaxed))
+          {
+             sync_wait(locked(inline_sender{}, write, data.lock), sink_receiver{&sink});
+             std::this_thread::yield();
+          }
+       })
+   {}
+
+   ~background_writer()
+   {
+      stop = true;
+   }
+};
+
+// Reads with optimistic_locked(), from 1 to 64 threads.
+void seqlock_optimistic_read(benchmark::State& state)
+{
+   std::optional<background_writer> writer;
+   if (state.thread_index() == 0 && state.range(0) != 0)
+     writer.emplace();
+
+   auto read = [](auto...) noexcept {
+      return data.first.load(std::memory_order_relaxed) - data.second.load(std::memory_order_relaxed);
+   };
+   long sink = 0;
+   for (auto _ : state)
+   {
+      sync_wait(optimistic_locked(inline_sender{}, read, data.lock), sink_receiver{&sink});
+      benchmark::DoNotOptimize(sink);
+   }
+   state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(seqlock_optimistic_read)->ArgName("writer")->Arg(0)->Arg(1)->ThreadRange(1, 64)->UseRealTime();
+
+// The same reads with the mutex of the seqlock held, for comparison.
+void seqlock_locked_read(benchmark::State& state)
+{
+   std::optional<background_writer> writer;
+   if (state.thread_index() == 0 && state.range(0) != 0)
+     writer.emplace();
+
+   long sink = 0;
+   for (auto _ : state)
+   {
+      {
+         std::lock_guard<async_mutex> lock(data.lock.mutex);
+         sink = data.first.load(std::memory_order_relaxed) - data.second.load(std::memory_order_relaxed);
+      }
+      benchmark::DoNotOptimize(sink);
+   }
+   state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(seqlock_locked_read)->ArgName("writer")->Arg(0)->Arg(1)->ThreadRange(1, 64)->UseRealTime();
+
+} // namespace
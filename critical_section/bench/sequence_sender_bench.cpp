@@ -0,0 +1,142 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "sequence_sender.hpp"
+#include "helpers.hpp"
+#include "locked_sender.hpp"
+#include "scheduled_sequence.hpp"
+#include "started_operation.hpp"
+#include "thread_pool.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <latch>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr std::int64_t item_count = 10'000'000;
+
+struct finished_receiver
+{
+   bool* finished;
+
+   void set_value() && noexcept
+   {
+      *finished = true;
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {}
+
+   void set_done() && noexcept
+   {}
+};
+
+auto accumulate_into(std::int64_t& sum)
+{
+   return [&sum](auto item) {
+      return then(std::move(item), [&sum](std::int64_t v) { sum += v; return v; });
+   };
+}
+
+template<typename Sequence>
+void run_sequence(benchmark::State& state, Sequence make_sequence)
+{
+   std::int64_t sum = 0;
+   for (auto _ : state)
+   {
+      bool finished = false;
+      started_operation op(for_each(make_sequence(), accumulate_into(sum)), finished_receiver{&finished});
+      if (!finished)
+        state.SkipWithError("sequence did not complete");
+      benchmark::DoNotOptimize(sum);
+   }
+   state.SetItemsProcessed(state.iterations() * item_count);
+}
+
+// Items of iota_sequence consumed by for_each, each completing inline, so
+// the producer loops in the trampoline.
+void sequence_for_each(benchmark::State& state)
+{
+   run_sequence(state, [] { return iota_sequence<std::int64_t>(0, item_count); });
+}
+BENCHMARK(sequence_for_each)->Unit(benchmark::kMillisecond);
+
+void sequence_take(benchmark::State& state)
+{
+   run_sequence(state, [] { return take(iota_sequence<std::int64_t>(0, 2 * item_count), item_count); });
+}
+BENCHMARK(sequence_take)->Unit(benchmark::kMillisecond);
+
+// Items passed through buffer() of the given capacity.
+void sequence_buffer(benchmark::State& state)
+{
+   auto count = static_cast<std::size_t>(state.range(0));
+   run_sequence(state, [=] { return buffer(iota_sequence<std::int64_t>(0, item_count), count); });
+}
+BENCHMARK(sequence_buffer)->Arg(1)->Arg(64)->Unit(benchmark::kMillisecond);
+
+struct latch_receiver
+{
+   std::latch* latch;
+
+   void set_value() && noexcept
+   {
+      latch->count_down();
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {
+      latch->count_down();
+   }
+
+   void set_done() && noexcept
+   {
+      latch->count_down();
+   }
+};
+
+// Items of two streams (item_count in total), run through locked() on the
+// same mutex; the items waiting for the lock are resumed on the pool, and
+// the producers continue from there.
+void sequence_locked_on_pool(benchmark::State& state)
+{
+   constexpr std::int64_t per_stream = item_count / 2;
+   // destroyed after the pool is joined, as the receiver may still be
+   // returning from count_down() on a worker
+   std::vector<std::shared_ptr<void>> ops;
+   thread_pool pool(2);
+   async_mutex m;
+   std::int64_t sum = 0;
+   auto work = [&sum](auto s) {
+      return then(std::move(s), [&sum](std::int64_t v) { sum += v; return v; });
+   };
+   auto each_locked = [&m, work](auto item) { return locked(std::move(item), work, m); };
+
+   for (auto _ : state)
+   {
+      std::latch latch(2);
+      for (int i = 0; i < 2; ++i)
+        ops.push_back(start_operation(
+          for_each(schedule_items_on(iota_sequence<std::int64_t>(0, per_stream), pool.scheduler()), each_locked),
+          latch_receiver{&latch}));
+      latch.wait();
+      benchmark::DoNotOptimize(sum);
+   }
+   state.SetItemsProcessed(state.iterations() * item_count);
+}
+BENCHMARK(sequence_locked_on_pool)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // namespace
@@ -0,0 +1,125 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "thread_pool.hpp"
+#include "allocation_counter.hpp"
+#include "cache_miss_counter.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstddef>
+#include <latch>
+
+namespace {
+
+struct latch_receiver
+{
+   std::latch* latch;
+
+   void set_value() && noexcept
+   {
+      latch->count_down();
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {}
+
+   void set_done() && noexcept
+   {}
+};
+
+// Time from submitting a task from outside of the pool, to its completion
+// being observed by the submitting thread.
+void schedule_latency(benchmark::State& state)
+{
+   thread_pool pool(1);
+   std::size_t allocations = allocation_count();
+   for (auto _ : state)
+   {
+      std::latch latch(1);
+      submit(pool.scheduler().schedule(), latch_receiver{&latch});
+      latch.wait();
+   }
+   state.counters["allocations"] = benchmark::Counter(
+     static_cast<double>(allocation_count() - allocations), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(schedule_latency)->UseRealTime();
+
+// Tasks submitted from outside of the pool, run by all workers.
+void schedule_throughput(benchmark::State& state)
+{
+   constexpr std::size_t batch = 10000;
+   thread_pool pool(static_cast<std::size_t>(state.range(0)));
+   std::size_t allocations = allocation_count();
+   for (auto _ : state)
+   {
+      std::latch latch(batch);
+      for (std::size_t i = 0; i < batch; ++i)
+        submit(pool.scheduler().schedule(), latch_receiver{&latch});
+      latch.wait();
+   }
+   state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * batch));
+   state.counters["allocations"] = benchmark::Counter(
+     static_cast<double>(allocation_count() - allocations) / batch, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(schedule_throughput)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+// Task that reschedules itself from the worker, until count tasks have run.
+struct chain_receiver
+{
+   thread_pool::scheduler_type sched;
+   std::size_t remaining;
+   std::latch* latch;
+
+   void set_value() && noexcept
+   {
+      if (remaining == 0)
+        return latch->count_down();
+      submit(sched.schedule(), chain_receiver{sched, remaining - 1, latch});
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {}
+
+   void set_done() && noexcept
+   {}
+};
+
+// Continuations scheduled from a worker: through the LIFO slot of the worker
+// (range 0), or through the shared queue, like the locks handed over (range 1).
+// Reports the cache misses per continuation, when perf events are available.
+void worker_continuations(benchmark::State& state)
+{
+   constexpr std::size_t chain = 10000;
+   constexpr std::size_t chains = 4;
+   cache_miss_counter misses;
+   {
+      thread_pool pool(4);
+      auto sched = state.range(0) ? pool.scheduler().handoff_scheduler() : pool.scheduler();
+      for (auto _ : state)
+      {
+         std::latch latch(chains);
+         for (std::size_t i = 0; i < chains; ++i)
+           submit(pool.scheduler().schedule(), chain_receiver{sched, chain, &latch});
+         latch.wait();
+      }
+   }
+   state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * chains * chain));
+   // the workers have exited, so their misses are counted
+   if (misses.available())
+     state.counters["cache_misses"] = benchmark::Counter(
+       static_cast<double>(misses.count()) / (chains * chain), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(worker_continuations)->ArgName("shared_queue")->Arg(0)->Arg(1)->UseRealTime();
+
+} // namespace
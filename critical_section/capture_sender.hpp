@@ -13,10 +13,14 @@
 #include "concepts.hpp"
 #endif // GODBOLT_COMPATIBLE
 
-#include <optional>
-#include <variant>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
 #include <tuple>
 #include <type_traits>
+#include <utility>
 
 template<typename... Values>
 struct received_values
@@ -40,6 +44,103 @@ struct received_error
 
 struct received_done {};
 
+// Storage for one of the alternatives, or none (the initial state). Unlike
+// std::optional<std::variant<...>>, the empty state is one of the values of
+// the index, so it costs one byte on top of the largest alternative (usually
+// absorbed by its padding). Alternatives must be distinct.
+template<typename... Alternatives>
+class compact_result
+{
+   static_assert(sizeof...(Alternatives) < 255, "too many alternatives");
+
+   static constexpr std::uint8_t empty = 255;
+   static constexpr std::size_t storage_size = std::max({std::size_t(1), sizeof(Alternatives)...});
+   static constexpr std::size_t storage_align = std::max({alignof(std::byte), alignof(Alternatives)...});
+
+   template<typename T>
+   static constexpr std::uint8_t index_of()
+   {
+      std::uint8_t result = 0;
+      bool found = ((++result, std::is_same_v<T, Alternatives>) || ...);
+      return found ? result - 1 : empty;
+   }
+
+public:
+   compact_result() = default;
+   compact_result(compact_result&&) = delete;
+
+   ~compact_result()
+   {
+      reset();
+   }
+
+   bool has_value() const
+   {
+      return index != empty;
+   }
+
+   template<typename T, typename... Args>
+   T& emplace(Args&&... args)
+   {
+      static_assert(index_of<T>() != empty, "not an alternative of the result");
+      reset();
+      T* result = ::new (static_cast<void*>(storage)) T(std::forward<Args>(args)...);
+      index = index_of<T>();
+      return *result;
+   }
+
+   // Invokes vis with the stored alternative; the result must not be empty.
+   template<typename Visitor>
+   void visit(Visitor&& vis)
+   {
+      visit_impl(vis, std::index_sequence_for<Alternatives...>{});
+   }
+
+private:
+   template<typename Visitor, std::size_t... I>
+   void visit_impl(Visitor& vis, std::index_sequence<I...>)
+   {
+      (void) ((index == I ? (vis(get<Alternatives>()), true) : false) || ...);
+   }
+
+   void reset()
+   {
+      [this]<std::size_t... I>(std::index_sequence<I...>) {
+         (void) ((index == I ? (get<Alternatives>().~Alternatives(), true) : false) || ...);
+      }(std::index_sequence_for<Alternatives...>{});
+      index = empty;
+   }
+
+   template<typename T>
+   T& get()
+   {
+      return *std::launder(reinterpret_cast<T*>(storage));
+   }
+
+   alignas(storage_align) std::byte storage[storage_size];
+   std::uint8_t index = empty;
+};
+
+// compact_result of Alternatives, with duplicates removed (e.g. several
+// std::exception_ptr errors share one alternative).
+template<typename Result, typename... Alternatives>
+struct unique_compact_result
+{
+   using type = Result;
+};
+
+template<typename... Unique, typename Head, typename... Tail>
+struct unique_compact_result<compact_result<Unique...>, Head, Tail...>
+  : unique_compact_result<
+      std::conditional_t<(std::is_same_v<Head, Unique> || ...),
+                         compact_result<Unique...>,
+                         compact_result<Unique..., Head>>,
+      Tail...>
+{};
+
+template<typename... Alternatives>
+using unique_compact_result_t = typename unique_compact_result<compact_result<>, Alternatives...>::type;
+
 template<typename... Args>
 using capture_value_tuple = received_values<std::remove_cvref_t<Args>...>;
 
@@ -50,13 +151,13 @@ struct capture_value_types
     struct capture_error_types
     {
        using with_done =
-         std::variant<
+         unique_compact_result_t<
            ValueArgs...,
            received_error<std::remove_cvref_t<ErrorArgs>>...,
            received_done>;
        
        using without_done =
-         std::variant<
+         unique_compact_result_t<
            ValueArgs...,
            received_error<std::remove_cvref_t<ErrorArgs>>...>;
         
@@ -80,29 +181,36 @@ template<receiver Receiver, typename StoredResult>
 struct capture_receiver
 {
     Receiver r;
-    std::optional<StoredResult>* res;
+    StoredResult* res;
     
     template<typename... Args>
-    void set_value(Args&&... args) && 
+      requires receiver_of<Receiver, StoredResult&>
+    void set_value(Args&&... args) &&
     {
         using type = received_values<std::remove_cvref_t<Args>...>;
-        res->emplace(std::in_place_type<type>, std::forward<Args>(args)...);
-        std::move(r).set_value(**res);
+        res->template emplace<type>(std::forward<Args>(args)...);
+        std::move(r).set_value(*res);
     }
     
     template<typename Arg>
     void set_error(Arg&& arg) && noexcept
     {
         using type = received_error<std::remove_cvref_t<Arg>>;
-        res->emplace(std::in_place_type<type>, std::forward<Arg>(arg));
-        std::move(r).set_value(**res);
+        res->template emplace<type>(std::forward<Arg>(arg));
+        std::move(r).set_value(*res);
     }
 
     void set_done() && noexcept
     {
         using type = received_done;
-        res->emplace(std::in_place_type<type>);
-        std::move(r).set_value(**res);
+        res->template emplace<type>();
+        std::move(r).set_value(*res);
+    }
+
+    auto get_allocator() const
+      requires receiver_with_allocator<Receiver>
+    {
+       return r.get_allocator();
     }
 };
 
@@ -119,7 +227,8 @@ struct capture_sender
     static constexpr bool sends_done = false;
     
     template<typename Receiver>
-      requires sender_to<Sender, Receiver>
+      requires receiver_of<Receiver, stored_result&>
+            && sender_to<Sender, capture_receiver<std::remove_cvref_t<Receiver>, stored_result>>
     friend auto connect(capture_sender wrapper, Receiver&& r) {
        using decayed_receiver = std::remove_cvref_t<Receiver>;
        using nested_receiver_type = capture_receiver<decayed_receiver, stored_result>;
@@ -127,7 +236,7 @@ struct capture_sender
 
        struct operation_type
        {
-          std::optional<stored_result> store;
+          stored_result store;
           nested_operation_type operation;
           
           explicit operation_type(Sender&& s, Receiver&& r)
@@ -15,15 +15,71 @@
 #include <functional>
 #include <type_traits>
 #include <concepts>
+#include <exception>
+#include <utility>
+
+template<typename... Ts>
+struct type_list {};
+
+template<typename R, typename E = std::exception_ptr>
+concept receiver =
+  std::move_constructible<std::remove_cvref_t<R>> &&
+  std::constructible_from<std::remove_cvref_t<R>, R> &&
+  requires (std::remove_cvref_t<R>&& r, E&& e) {
+    std::move(r).set_done();
+    std::move(r).set_error((E&&) e);
+  };
 
-template<typename R>
-concept receiver = true;
+template<typename R, typename... Args>
+concept receiver_of = receiver<R> &&
+  requires (std::remove_cvref_t<R>&& r, Args&&... args) {
+    std::move(r).set_value((Args&&) args...);
+  };
 
 template<typename R, typename... Args>
-concept receiver_of = receiver<R> && true;
+concept nothrow_receiver_of = receiver_of<R, Args...> &&
+  requires (std::remove_cvref_t<R>&& r, Args&&... args) {
+    { std::move(r).set_value((Args&&) args...) } noexcept;
+  };
+
+// Error types of the senders, that report only exceptions thrown by
+// set_value of the receiver: none if the exceptions are disabled.
+#if __cpp_exceptions
+template<template<class...> class Variant>
+using set_value_error_types = Variant<std::exception_ptr>;
+#else
+template<template<class...> class Variant>
+using set_value_error_types = Variant<>;
+#endif
+
+// Invokes set_value of the receiver, and passes the exception thrown by it
+// to set_error. The handler is omitted if set_value is noexcept, or the
+// exceptions are disabled.
+template<typename Receiver, typename... Args>
+  requires receiver_of<Receiver, Args...>
+void set_value_or_error(Receiver&& r, Args&&... args) noexcept
+{
+#if __cpp_exceptions
+   if constexpr (!nothrow_receiver_of<Receiver, Args...>)
+   {
+      try
+      {
+         std::forward<Receiver>(r).set_value(std::forward<Args>(args)...);
+      }
+      catch(...)
+      {
+         std::forward<Receiver>(r).set_error(std::current_exception());
+      }
+   }
+   else
+#endif
+   {
+      std::forward<Receiver>(r).set_value(std::forward<Args>(args)...);
+   }
+}
 
 template<typename S>
-concept sender = true;
+concept sender = std::move_constructible<std::remove_cvref_t<S>>;
 
 template<template<template<class...> class Tuple, template<class...> class Variant> class>
 struct has_value_types; // exposition only
@@ -44,11 +100,86 @@ concept typed_sender =
   sender<S> &&
   has_sender_types<std::remove_cvref_t<S>>;
 
+template<typename S>
+struct sender_traits 
+{
+    template<template<class...> class Tuple, template<class...> class Variant>
+    using value_types = typename S::template value_types<Tuple, Variant>;
+
+    template<template<class...> class Variant>
+    using error_types = typename S::template error_types<Variant>;
+
+    static constexpr bool sends_done = S::sends_done;
+};
+
+// Sender that completes with set_value() without arguments.
+template<typename S>
+concept void_sender =
+  typed_sender<S> &&
+  std::same_as<
+    typename sender_traits<std::remove_cvref_t<S>>::template value_types<type_list, type_list>,
+    type_list<type_list<>>>;
+
+template<typename R>
+struct receiver_of_values
+{
+   template<typename... Args>
+   using tuple = std::bool_constant<receiver_of<R, Args...>>;
+
+   template<typename... Tuples>
+   using variant = std::bool_constant<(Tuples::value && ...)>;
+};
+
+// Receiver accepting every set_value completion of the typed sender. Adaptors
+// forwarding the values of the sender they wrap check it in the constraints
+// of connect(), instead of failing inside of its (deduced return type) body.
+template<typename R, typename S>
+concept receiver_for = typed_sender<S> &&
+  sender_traits<std::remove_cvref_t<S>>::template value_types<
+    receiver_of_values<R>::template tuple, receiver_of_values<R>::template variant>::value;
+
+// Variant of the types of all type_lists, in order (duplicates are kept).
+template<template<class...> class Variant, typename... Lists>
+struct concat_type_lists;
+
+template<template<class...> class Variant, typename... Ts>
+struct concat_type_lists<Variant, type_list<Ts...>>
+{
+   using type = Variant<Ts...>;
+};
+
+template<template<class...> class Variant, typename... Ts, typename... Us, typename... Rest>
+struct concat_type_lists<Variant, type_list<Ts...>, type_list<Us...>, Rest...>
+  : concat_type_lists<Variant, type_list<Ts..., Us...>, Rest...>
+{};
+
+// Sender types of S if it is typed, for adaptors forwarding its completions.
+template<sender S>
+struct forwarded_sender_types
+{};
+
+template<typed_sender S>
+struct forwarded_sender_types<S>
+{
+   template<template<class...> class Tuple, template<class...> class Variant>
+     using value_types = typename sender_traits<S>::template value_types<Tuple, Variant>;
+   template<template<class...> class Variant>
+     using error_types = typename sender_traits<S>::template error_types<Variant>;
+   static constexpr bool sends_done = sender_traits<S>::sends_done;
+};
+
 template<typename S, typename R>
-concept sender_to = sender<R> && receiver<R> && true;
+concept sender_to = sender<S> && receiver<R> &&
+  requires (S&& s, R&& r) {
+    connect((S&&) s, (R&&) r);
+  };
 
 template<typename S>
-concept scheduler = true;
+concept scheduler =
+  std::copy_constructible<std::remove_cvref_t<S>> &&
+  requires (std::remove_cvref_t<S>&& s) {
+    { std::move(s).schedule() } -> void_sender;
+  };
 
 template<typename S>
 concept sender_with_scheduler = sender<S> && 
@@ -56,17 +187,49 @@ concept sender_with_scheduler = sender<S> &&
     { s.scheduler() } -> scheduler;
   };
 
+// Scheduler that completes schedule() synchronously on the thread calling
+// start(), so transferring execution to it is a no-op. Schedulers advertise
+// it with a static constexpr bool is_inline member set to true.
 template<typename S>
-struct sender_traits 
-{
-    template<template<class...> class Tuple, template<class...> class Variant>
-    using value_types = typename S::template value_types<Tuple, Variant>;
+struct is_inline_scheduler
+  : std::bool_constant<requires { requires std::remove_cvref_t<S>::is_inline; }>
+{};
 
-    template<template<class...> class Variant>
-    using error_types = typename S::template error_types<Variant>;
+template<typename S>
+inline constexpr bool is_inline_scheduler_v = is_inline_scheduler<S>::value;
 
-    static constexpr bool sends_done = S::sends_done;
-};
+// Returns true if the calling thread is already an execution agent of the
+// scheduler, so the work scheduled on it may continue inline.
+template<scheduler Scheduler>
+bool on_same_worker(Scheduler const& sched)
+{
+  if constexpr (is_inline_scheduler_v<Scheduler>)
+    return true;
+  else if constexpr (requires { { sched.on_same_worker() } -> std::convertible_to<bool>; })
+    return sched.on_same_worker();
+  else
+    return false;
+}
+
+// Returns the scheduler to resume the work handed over by the calling thread,
+// like the next owner of a released lock: handoff_scheduler() of the
+// scheduler if present, otherwise the scheduler itself. The calling thread
+// may block after the hand-off (e.g. to lock the mutex again), so the work
+// must not be queued behind its current task.
+template<scheduler Scheduler>
+Scheduler handoff_scheduler(Scheduler const& sched)
+{
+  if constexpr (requires { { sched.handoff_scheduler() } -> std::same_as<Scheduler>; })
+    return sched.handoff_scheduler();
+  else
+    return sched;
+}
+
+template<typename R>
+concept receiver_with_allocator = receiver<R> &&
+  requires (std::remove_cvref_t<R> const& r) {
+    r.get_allocator();
+  };
 
 template<sender S, receiver R>
 using operation_state_type = decltype(connect(std::declval<S>(), std::declval<R>()));
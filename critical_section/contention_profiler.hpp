@@ -0,0 +1,264 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#ifndef GODBOLT_COMPATIBLE
+#pragma once
+#endif // GODBOLT_COMPATIBLE
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <source_location>
+#include <vector>
+
+// Per call site statistics of locked(), collected only when
+// CRITICAL_SECTION_PROFILE_CONTENTION is defined.
+struct contention_report_entry
+{
+   char const* file_name;
+   char const* function_name;
+   std::uint_least32_t line;
+   std::uint_least32_t column;
+   std::uint64_t acquisitions;
+   std::uint64_t contended;
+   std::uint64_t total_wait_ns;
+};
+
+// Table of locked() call sites. Sites are registered without locking in
+// a fixed-size open addressing table, and each acquisition updates only
+// relaxed counters of its site, sharded by the thread so threads locking at
+// the same site do not share cache lines. The wait is timed only for the
+// sampled acquisitions (see set_sampling_period), and the total wait time
+// of the site is estimated from them.
+class contention_profiler
+{
+public:
+   static constexpr std::size_t max_sites = 4096;
+   static constexpr std::size_t shard_count = 4;
+   static constexpr std::uint32_t default_sampling_period = 16;
+
+   struct alignas(64) counters
+   {
+      std::atomic<std::uint64_t> acquisitions{0};
+      std::atomic<std::uint64_t> contended{0};
+      // contended acquisitions that were timed, and their total wait
+      std::atomic<std::uint64_t> timed{0};
+      std::atomic<std::uint64_t> timed_wait_ns{0};
+   };
+
+   struct site
+   {
+      alignas(64) std::atomic<std::uint64_t> key{0};
+      std::atomic<bool> ready{false};
+      std::source_location location;
+      std::array<counters, shard_count> shards;
+
+      counters& local_counters()
+      {
+         return shards[shard_index()];
+      }
+   };
+
+   // Returns the statistics of the call site, nullptr if the table is full.
+   static site* find(std::source_location const& loc)
+   {
+      std::uint64_t key = key_of(loc);
+      auto& table = sites();
+      for (std::size_t i = 0; i < max_sites; ++i)
+      {
+         site& s = table[(key + i) % max_sites];
+         std::uint64_t current = s.key.load(std::memory_order_acquire);
+         if (current == 0 && s.key.compare_exchange_strong(current, key, std::memory_order_acq_rel))
+         {
+            s.location = loc;
+            s.ready.store(true, std::memory_order_release);
+            return &s;
+         }
+         if (current == key)
+           return &s;
+      }
+      return nullptr;
+   }
+
+   // Like find(), but each thread looks up a call site in the table only
+   // once, and then in a small cache of its own.
+   static site* resolve(std::source_location const& loc)
+   {
+      struct cached_site
+      {
+         char const* file_name = nullptr;
+         std::uint_least32_t line = 0;
+         std::uint_least32_t column = 0;
+         site* stats = nullptr;
+      };
+      thread_local std::array<cached_site, 64> cache;
+
+      cached_site& entry = cache[(loc.line() * 31u + loc.column()) % cache.size()];
+      if (entry.stats && entry.line == loc.line() && entry.column == loc.column()
+          && entry.file_name == loc.file_name())
+        return entry.stats;
+
+      site* stats = find(loc);
+      if (stats)
+        entry = {loc.file_name(), loc.line(), loc.column(), stats};
+      return stats;
+   }
+
+   // Times one of every period acquisitions of each thread; 1 times all.
+   static void set_sampling_period(std::uint32_t period)
+   {
+      sampling_period().store(period == 0 ? 1 : period, std::memory_order_relaxed);
+   }
+
+   static bool sample()
+   {
+      thread_local std::uint32_t acquisitions = 0;
+      return ++acquisitions % sampling_period().load(std::memory_order_relaxed) == 0;
+   }
+
+   // Call sites sorted by the total wait time, descending.
+   static std::vector<contention_report_entry> report()
+   {
+      std::vector<contention_report_entry> result;
+      for (site const& s : sites())
+      {
+         if (!s.ready.load(std::memory_order_acquire))
+           continue;
+
+         std::uint64_t acquisitions = 0, contended = 0, timed = 0, timed_wait_ns = 0;
+         for (counters const& c : s.shards)
+         {
+            acquisitions += c.acquisitions.load(std::memory_order_relaxed);
+            contended += c.contended.load(std::memory_order_relaxed);
+            timed += c.timed.load(std::memory_order_relaxed);
+            timed_wait_ns += c.timed_wait_ns.load(std::memory_order_relaxed);
+         }
+
+         std::uint64_t total_wait_ns = 0;
+         if (timed != 0)
+           total_wait_ns = static_cast<std::uint64_t>(
+             static_cast<double>(timed_wait_ns) / static_cast<double>(timed) * static_cast<double>(contended));
+
+         result.push_back({s.location.file_name(), s.location.function_name(),
+                           s.location.line(), s.location.column(),
+                           acquisitions, contended, total_wait_ns});
+      }
+
+      std::sort(result.begin(), result.end(), [](auto const& lhs, auto const& rhs) {
+         return lhs.total_wait_ns > rhs.total_wait_ns;
+      });
+      return result;
+   }
+
+   // Clears the counters, registered call sites are kept.
+   static void reset()
+   {
+      for (site& s : sites())
+        for (counters& c : s.shards)
+        {
+           c.acquisitions.store(0, std::memory_order_relaxed);
+           c.contended.store(0, std::memory_order_relaxed);
+           c.timed.store(0, std::memory_order_relaxed);
+           c.timed_wait_ns.store(0, std::memory_order_relaxed);
+        }
+   }
+
+private:
+   static std::uint64_t key_of(std::source_location const& loc)
+   {
+      auto file = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(loc.file_name()));
+      std::uint64_t key = file * 0x9E3779B97F4A7C15ull ^ (std::uint64_t(loc.line()) << 20) ^ loc.column();
+      return key == 0 ? 1 : key;
+   }
+
+   static std::size_t shard_index()
+   {
+      static std::atomic<std::size_t> next_thread{0};
+      thread_local std::size_t index = next_thread.fetch_add(1, std::memory_order_relaxed) % shard_count;
+      return index;
+   }
+
+   static std::atomic<std::uint32_t>& sampling_period()
+   {
+      static std::atomic<std::uint32_t> period{default_sampling_period};
+      return period;
+   }
+
+   static std::array<site, max_sites>& sites()
+   {
+      static std::array<site, max_sites> table;
+      return table;
+   }
+};
+
+// Identifies the locked() call; empty unless the profiling is enabled.
+struct lock_call_site
+{
+#ifdef CRITICAL_SECTION_PROFILE_CONTENTION
+   contention_profiler::site* stats = nullptr;
+
+   explicit lock_call_site(std::source_location const& loc)
+     : stats(contention_profiler::resolve(loc))
+   {}
+#else
+   explicit lock_call_site(std::source_location const&)
+   {}
+#endif
+};
+
+// Measures a single acquisition of the mutex, stored in the locking operation.
+// An acquisition is contended if the lock was handed over by async_mutex::deque,
+// rather than granted by async_mutex::enqueue.
+struct contention_probe
+{
+#ifdef CRITICAL_SECTION_PROFILE_CONTENTION
+   contention_profiler::site* stats = nullptr;
+   // the epoch if the acquisition is not timed
+   std::chrono::steady_clock::time_point enqueued;
+
+   // Invoked before async_mutex::enqueue, as the lock may be handed over
+   // before enqueue returns.
+   void enqueuing(lock_call_site site)
+   {
+      stats = site.stats;
+      if (!stats)
+        return;
+
+      stats->local_counters().acquisitions.fetch_add(1, std::memory_order_relaxed);
+      if (contention_profiler::sample())
+        enqueued = std::chrono::steady_clock::now();
+   }
+
+   void handed_over()
+   {
+      if (!stats)
+        return;
+
+      contention_profiler::counters& c = stats->local_counters();
+      c.contended.fetch_add(1, std::memory_order_relaxed);
+      if (enqueued == std::chrono::steady_clock::time_point())
+        return;
+
+      auto wait = std::chrono::steady_clock::now() - enqueued;
+      auto wait_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(wait).count();
+      c.timed.fetch_add(1, std::memory_order_relaxed);
+      c.timed_wait_ns.fetch_add(static_cast<std::uint64_t>(wait_ns), std::memory_order_relaxed);
+   }
+#else
+   void enqueuing(lock_call_site)
+   {}
+
+   void handed_over()
+   {}
+#endif
+};
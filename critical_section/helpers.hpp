@@ -81,7 +81,7 @@ struct inline_sender
     template<template<class...> class Tuple, template<class...> class Variant>
       using value_types = Variant<Tuple<>>;
     template<template<class...> class Variant>
-      using error_types = Variant<std::exception_ptr>;
+      using error_types = set_value_error_types<Variant>;
     static constexpr bool sends_done = false;
     
     template<typename Receiver>
@@ -92,14 +92,7 @@ struct inline_sender
           
           void start()
           {
-             try
-             {
-                std::move(r).set_value();
-             }
-             catch(...)
-             {
-               std::move(r).set_error(std::current_exception());
-             }
+             set_value_or_error(std::move(r));
           };
 
        };
@@ -113,6 +106,8 @@ struct inline_sender
 
 struct inline_scheduler
 {
+  static constexpr bool is_inline = true;
+
   inline_sender schedule()
   {
      return {};
@@ -129,25 +124,18 @@ struct just10_sender
     template<template<class...> class Tuple, template<class...> class Variant>
       using value_types = Variant<Tuple<int>>;
     template<template<class...> class Variant>
-      using error_types = Variant<std::exception_ptr>;
+      using error_types = set_value_error_types<Variant>;
     static constexpr bool sends_done = false;
     
     template<typename Receiver>
-      requires receiver_of<Receiver>
+      requires receiver_of<Receiver, int>
     friend auto connect(just10_sender, Receiver&& r) {
        struct operation {
           std::remove_cvref_t<Receiver> r;
           
           void start()
           {
-             try
-             {
-                std::move(r).set_value(10);
-             }
-             catch(...)
-             {
-               std::move(r).set_error(std::current_exception());
-             }
+             set_value_or_error(std::move(r), 10);
           };
 
        };
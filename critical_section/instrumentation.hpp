@@ -0,0 +1,509 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#ifndef GODBOLT_COMPATIBLE
+#pragma once
+#endif // GODBOLT_COMPATIBLE
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+// Instrumentation of thread_pool and async_mutex is compiled in only when
+// CRITICAL_SECTION_TRACING is defined; otherwise all hooks are empty types
+// and no-op inline functions.
+#ifdef CRITICAL_SECTION_TRACING
+inline constexpr bool tracing_enabled = true;
+#else
+inline constexpr bool tracing_enabled = false;
+#endif
+
+// Counts of values (nanoseconds, queue lengths) in log-linear buckets: 8 linear
+// sub-buckets per power of two, so the relative error is below 12.5%.
+struct histogram_snapshot
+{
+   static constexpr unsigned sub_bucket_bits = 3;
+   static constexpr std::size_t sub_bucket_count = std::size_t(1) << sub_bucket_bits;
+   static constexpr std::size_t bucket_count = (64 - sub_bucket_bits + 1) * sub_bucket_count;
+
+   std::array<std::uint64_t, bucket_count> counts{};
+
+   static std::size_t bucket_of(std::uint64_t value)
+   {
+      if (value < sub_bucket_count)
+        return static_cast<std::size_t>(value);
+
+      unsigned shift = static_cast<unsigned>(std::bit_width(value)) - 1 - sub_bucket_bits;
+      return (shift + 1) * sub_bucket_count + static_cast<std::size_t>((value >> shift) - sub_bucket_count);
+   }
+
+   static std::uint64_t lowest_value(std::size_t bucket)
+   {
+      if (bucket < sub_bucket_count)
+        return bucket;
+
+      std::size_t shift = bucket / sub_bucket_count - 1;
+      return (std::uint64_t(bucket % sub_bucket_count) + sub_bucket_count) << shift;
+   }
+
+   std::uint64_t total() const
+   {
+      std::uint64_t result = 0;
+      for (std::uint64_t c : counts)
+        result += c;
+      return result;
+   }
+
+   // Lowest value of the bucket containing the given percentile (0-100).
+   std::uint64_t percentile(double p) const
+   {
+      std::uint64_t count = total();
+      if (count == 0)
+        return 0;
+
+      auto rank = static_cast<std::uint64_t>(p / 100.0 * static_cast<double>(count - 1));
+      std::uint64_t seen = 0;
+      for (std::size_t i = 0; i < bucket_count; ++i)
+      {
+         seen += counts[i];
+         if (seen > rank)
+           return lowest_value(i);
+      }
+      return lowest_value(bucket_count - 1);
+   }
+
+   histogram_snapshot& operator+=(histogram_snapshot const& other)
+   {
+      for (std::size_t i = 0; i < bucket_count; ++i)
+        counts[i] += other.counts[i];
+      return *this;
+   }
+};
+
+// Histograms of the instrumented objects, kept outside of them so the
+// objects stay small: each thread records into its own table, keyed by the
+// object and the histogram, and snapshot() sums the tables of all threads.
+// The table of an exited thread is reused by the next thread, so the counts
+// recorded by it are kept.
+class histogram_registry
+{
+public:
+   static void record(void const* object, std::size_t histogram, std::uint64_t value)
+   {
+      thread_table& table = local_table();
+      // contended only by snapshot() and forget()
+      std::lock_guard<std::mutex> lock(table.m);
+      ++table.histograms[{object, histogram}].counts[histogram_snapshot::bucket_of(value)];
+   }
+
+   static histogram_snapshot snapshot(void const* object, std::size_t histogram)
+   {
+      histogram_snapshot result;
+      std::lock_guard<std::mutex> registry_lock(registry().m);
+      for (auto const& table : registry().tables)
+      {
+         std::lock_guard<std::mutex> lock(table->m);
+         auto it = table->histograms.find({object, histogram});
+         if (it != table->histograms.end())
+           result += it->second;
+      }
+      return result;
+   }
+
+   // Drops the histograms of the object, that is destroyed, so an object
+   // created later at the same address starts with empty ones.
+   static void forget(void const* object)
+   {
+      std::lock_guard<std::mutex> registry_lock(registry().m);
+      for (auto const& table : registry().tables)
+      {
+         std::lock_guard<std::mutex> lock(table->m);
+         std::erase_if(table->histograms, [object](auto const& entry) { return entry.first.object == object; });
+      }
+   }
+
+private:
+   struct key
+   {
+      void const* object;
+      std::size_t histogram;
+
+      friend bool operator==(key const&, key const&) = default;
+   };
+
+   struct key_hash
+   {
+      std::size_t operator()(key const& k) const noexcept
+      {
+         return std::hash<void const*>()(k.object) ^ k.histogram;
+      }
+   };
+
+   struct thread_table
+   {
+      std::mutex m;
+      std::unordered_map<key, histogram_snapshot, key_hash> histograms;
+      // guarded by the mutex of the registry
+      bool in_use = true;
+   };
+
+   struct table_registry
+   {
+      std::mutex m;
+      std::vector<std::unique_ptr<thread_table>> tables;
+   };
+
+   static table_registry& registry()
+   {
+      static table_registry instance;
+      return instance;
+   }
+
+   // Table used by a thread, until it exits.
+   struct table_lease
+   {
+      thread_table* table;
+
+      table_lease()
+      {
+         std::lock_guard<std::mutex> lock(registry().m);
+         for (auto& candidate : registry().tables)
+           if (!candidate->in_use)
+           {
+              candidate->in_use = true;
+              table = candidate.get();
+              return;
+           }
+
+         registry().tables.push_back(std::make_unique<thread_table>());
+         table = registry().tables.back().get();
+      }
+
+      table_lease(table_lease&&) = delete;
+
+      ~table_lease()
+      {
+         std::lock_guard<std::mutex> lock(registry().m);
+         table->in_use = false;
+      }
+   };
+
+   static thread_table& local_table()
+   {
+      thread_local table_lease lease;
+      return *lease.table;
+   }
+};
+
+// Point in time, empty if tracing is disabled.
+struct trace_stamp
+{
+#ifdef CRITICAL_SECTION_TRACING
+   std::uint64_t ns = 0;
+#endif
+
+   static trace_stamp now()
+   {
+#ifdef CRITICAL_SECTION_TRACING
+      auto since_epoch = std::chrono::steady_clock::now().time_since_epoch();
+      return {static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch).count())};
+#else
+      return {};
+#endif
+   }
+
+   friend std::uint64_t operator-(trace_stamp end, trace_stamp start)
+   {
+#ifdef CRITICAL_SECTION_TRACING
+      return end.ns - start.ns;
+#else
+      (void) end;
+      (void) start;
+      return 0;
+#endif
+   }
+};
+
+// Complete span ("ph":"X" event of the Chrome trace format).
+struct trace_event
+{
+   char const* name;
+   char const* category;
+   void const* object;
+   std::uint64_t start_ns;
+   std::uint64_t duration_ns;
+};
+
+// Keeps last events of the program, in a ring buffer per thread. The ring
+// is allocated in chunks, when events are written to them, and the buffer
+// of an exited thread is reused by the next thread that records an event,
+// so the memory is bounded by the number of threads running at once; the
+// "tid" of the events identifies the buffer.
+class trace_recorder
+{
+public:
+   static constexpr std::size_t events_per_chunk = std::size_t(1) << 12;
+   static constexpr std::size_t chunks_per_thread = 16;
+   static constexpr std::size_t events_per_thread = events_per_chunk * chunks_per_thread;
+
+   static void record(char const* name, char const* category, void const* object,
+                      trace_stamp start, trace_stamp end)
+   {
+#ifdef CRITICAL_SECTION_TRACING
+      thread_buffer& buffer = local_buffer();
+      std::lock_guard<std::mutex> lock(buffer.m);
+      buffer.slot(buffer.next++) = {name, category, object, start.ns, end - start};
+#else
+      (void) name;
+      (void) category;
+      (void) object;
+      (void) start;
+      (void) end;
+#endif
+   }
+
+   // Writes recorded events in the Chrome trace-event JSON format,
+   // that can be loaded in chrome://tracing or Perfetto.
+   static void write_chrome_trace(std::ostream& out)
+   {
+      out << "{\"traceEvents\":[";
+      bool first = true;
+      std::lock_guard<std::mutex> registry_lock(registry().m);
+      for (auto const& buffer : registry().buffers)
+      {
+         std::lock_guard<std::mutex> lock(buffer->m);
+         std::size_t count = std::min(buffer->next, events_per_thread);
+         for (std::size_t i = buffer->next - count; i != buffer->next; ++i)
+         {
+            trace_event const& e = buffer->slot(i);
+            out << (first ? "" : ",")
+                << "{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_id
+                << ",\"ts\":" << microseconds{e.start_ns}
+                << ",\"dur\":" << microseconds{e.duration_ns}
+                << ",\"args\":{\"object\":\"" << e.object << "\"}}";
+            first = false;
+         }
+      }
+      out << "]}";
+   }
+
+   // Number of the per-thread buffers created so far.
+   static std::size_t buffer_count()
+   {
+      std::lock_guard<std::mutex> lock(registry().m);
+      return registry().buffers.size();
+   }
+
+private:
+   // Prints nanoseconds as microseconds with three decimal digits.
+   struct microseconds
+   {
+      std::uint64_t ns;
+
+      friend std::ostream& operator<<(std::ostream& out, microseconds us)
+      {
+         return out << us.ns / 1000 << '.'
+                    << char('0' + us.ns / 100 % 10) << char('0' + us.ns / 10 % 10) << char('0' + us.ns % 10);
+      }
+   };
+
+   struct thread_buffer
+   {
+      std::mutex m;
+      std::uint32_t thread_id;
+      std::size_t next = 0;
+      // guarded by the mutex of the registry
+      bool in_use = true;
+      std::array<std::unique_ptr<trace_event[]>, chunks_per_thread> chunks;
+
+      trace_event& slot(std::size_t index)
+      {
+         auto& chunk = chunks[index / events_per_chunk % chunks_per_thread];
+         if (!chunk)
+           chunk.reset(new trace_event[events_per_chunk]);
+         return chunk[index % events_per_chunk];
+      }
+   };
+
+   struct buffer_registry
+   {
+      std::mutex m;
+      std::vector<std::unique_ptr<thread_buffer>> buffers;
+   };
+
+   static buffer_registry& registry()
+   {
+      static buffer_registry instance;
+      return instance;
+   }
+
+   // Buffer used by a thread, until it exits.
+   struct buffer_lease
+   {
+      thread_buffer* buffer;
+
+      buffer_lease()
+      {
+         std::lock_guard<std::mutex> lock(registry().m);
+         for (auto& candidate : registry().buffers)
+           if (!candidate->in_use)
+           {
+              candidate->in_use = true;
+              buffer = candidate.get();
+              return;
+           }
+
+         registry().buffers.push_back(std::make_unique<thread_buffer>());
+         buffer = registry().buffers.back().get();
+         buffer->thread_id = static_cast<std::uint32_t>(registry().buffers.size());
+      }
+
+      buffer_lease(buffer_lease&&) = delete;
+
+      ~buffer_lease()
+      {
+         std::lock_guard<std::mutex> lock(registry().m);
+         buffer->in_use = false;
+      }
+   };
+
+   static thread_buffer& local_buffer()
+   {
+      thread_local buffer_lease lease;
+      return *lease.buffer;
+   }
+};
+
+// Statistics of thread_pool: time between enque() and start of the task
+// in nanoseconds, and the number of the tasks left in the queue.
+struct pool_instrumentation
+{
+   enum : std::size_t { queue_latency_histogram, queue_depth_histogram };
+
+   pool_instrumentation() = default;
+   pool_instrumentation(pool_instrumentation&&) = delete;
+
+#ifdef CRITICAL_SECTION_TRACING
+   ~pool_instrumentation()
+   {
+      histogram_registry::forget(this);
+   }
+#endif
+
+   void task_started(void const* pool, trace_stamp enqueued, std::size_t depth)
+   {
+#ifdef CRITICAL_SECTION_TRACING
+      trace_stamp started = trace_stamp::now();
+      histogram_registry::record(this, queue_latency_histogram, started - enqueued);
+      histogram_registry::record(this, queue_depth_histogram, depth);
+      trace_recorder::record("queued", "thread_pool", pool, enqueued, started);
+#else
+      (void) pool;
+      (void) enqueued;
+      (void) depth;
+#endif
+   }
+
+   histogram_snapshot queue_latency() const
+   {
+      return histogram_registry::snapshot(this, queue_latency_histogram);
+   }
+
+   histogram_snapshot queue_depth() const
+   {
+      return histogram_registry::snapshot(this, queue_depth_histogram);
+   }
+};
+
+// Timestamps of the waiter of async_mutex.
+struct handle_trace
+{
+#ifdef CRITICAL_SECTION_TRACING
+   trace_stamp enqueued;
+   trace_stamp granted;
+#endif
+};
+
+// Statistics of async_mutex: time between enqueue of the waiter and
+// acquiring the lock, and the time the lock was held, in nanoseconds.
+// The hooks are invoked outside of the internal lock of the mutex, as
+// recording may lock and allocate.
+struct mutex_instrumentation
+{
+   enum : std::size_t { wait_time_histogram, hold_time_histogram };
+
+   mutex_instrumentation() = default;
+   mutex_instrumentation(mutex_instrumentation&&) = delete;
+
+#ifdef CRITICAL_SECTION_TRACING
+   ~mutex_instrumentation()
+   {
+      histogram_registry::forget(this);
+   }
+#endif
+
+   // Invoked before the waiter is enqueued.
+   void enqueued(handle_trace& trace)
+   {
+#ifdef CRITICAL_SECTION_TRACING
+      trace.enqueued = trace_stamp::now();
+#else
+      (void) trace;
+#endif
+   }
+
+   // Invoked by the thread that granted the lock to the waiter, before the
+   // waiter is resumed; mutex is null if the lock was acquired on enqueue,
+   // and no wait is traced.
+   void granted(void const* mutex, handle_trace& trace)
+   {
+#ifdef CRITICAL_SECTION_TRACING
+      trace.granted = trace_stamp::now();
+      histogram_registry::record(this, wait_time_histogram, trace.granted - trace.enqueued);
+      if (mutex)
+        trace_recorder::record("wait", "async_mutex", mutex, trace.enqueued, trace.granted);
+#else
+      (void) mutex;
+      (void) trace;
+#endif
+   }
+
+   void released(void const* mutex, handle_trace& trace)
+   {
+#ifdef CRITICAL_SECTION_TRACING
+      trace_stamp now = trace_stamp::now();
+      histogram_registry::record(this, hold_time_histogram, now - trace.granted);
+      trace_recorder::record("hold", "async_mutex", mutex, trace.granted, now);
+#else
+      (void) mutex;
+      (void) trace;
+#endif
+   }
+
+   histogram_snapshot wait_time() const
+   {
+      return histogram_registry::snapshot(this, wait_time_histogram);
+   }
+
+   histogram_snapshot hold_time() const
+   {
+      return histogram_registry::snapshot(this, hold_time_histogram);
+   }
+};
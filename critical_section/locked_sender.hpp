@@ -14,41 +14,73 @@
 #include "capture_sender.hpp"
 #include "resume_via_sender.hpp"
 #include "async_mutex.hpp"
+#include "contention_profiler.hpp"
 #endif // GODBOLT_COMPATIBLE
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <source_location>
 
-template<typename Scheduler, typename Receiver, typename Operation>
+
+template<typename Operation>
 struct lock_mutex_receiver
 {
-   Scheduler sched;
-   Receiver recv;
    Operation* op;
    
    template<typename Arg>   
    void set_value(Arg& args)
    {
-     op->follow_op.emplace(init_from_invoke{[this, &args] {
-        return connect(resume_via(std::move(sched), args), std::move(recv));
-     }});
-     
-     if (op->mutex->enqueue(op))
-       std::move(*op->follow_op).start();
+     op->lock(args);
+   }
+
+   // capture_args() delivers errors and done as values, these are never invoked
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {
+     std::terminate();
+   }
+
+   void set_done() && noexcept
+   {
+     std::terminate();
    }
 };
 
 template<typename Arg, typename...g>
 using first_type = Arg;
 
+// Values and errors of Sender, delivered through the Scheduler, whose errors
+// are added, as are the exceptions thrown by set_value of the receiver.
 template<typed_sender Sender, scheduler Scheduler>
-struct lock_mutex_sender
+struct resumed_sender_types
+{
+   using schedule_sender = decltype(std::declval<Scheduler>().schedule());
+
+   template<template<class...> class Tuple, template<class...> class Variant>
+     using value_types = typename sender_traits<Sender>::template value_types<Tuple, Variant>;
+   template<template<class...> class Variant>
+     using error_types = typename concat_type_lists<
+       Variant,
+       typename sender_traits<Sender>::template error_types<type_list>,
+       typename sender_traits<schedule_sender>::template error_types<type_list>,
+       set_value_error_types<type_list>>::type;
+   static constexpr bool sends_done = sender_traits<Sender>::sends_done || sender_traits<schedule_sender>::sends_done;
+};
+
+template<typed_sender Sender, scheduler Scheduler>
+struct lock_mutex_sender : resumed_sender_types<Sender, Scheduler>
 {
    Sender send;
    Scheduler sched;
    async_mutex* mutex;
    handle_base** save_handle;
+   [[no_unique_address]] lock_call_site site;
    
    template<typename Receiver>
-     requires sender_to<Sender, Receiver>
+     requires receiver_for<Receiver, Sender>
    friend auto connect(lock_mutex_sender wrap, Receiver&& r)
    {
       using decayed_receiver = std::remove_cvref_t<Receiver>;
@@ -56,23 +88,30 @@ struct lock_mutex_sender
       struct operation_type : handle_base
       {
          async_mutex* mutex;
+         [[no_unique_address]] lock_call_site site;
+         [[no_unique_address]] contention_probe probe;
+         Scheduler sched;
+         decayed_receiver recv;
       
          using leading_sender = decltype(capture_args(std::move(send)));
-         using leading_receiver = lock_mutex_receiver<Scheduler, decayed_receiver, operation_type>;
+         using leading_receiver = lock_mutex_receiver<operation_type>;
          using leading_operation = operation_state_type<leading_sender, leading_receiver>;
          leading_operation leading_op;
          
-         using stored_args = typename sender_traits<leading_sender>::template value_types<first_type, first_type>;
+         using stored_args = std::remove_reference_t<
+           typename sender_traits<leading_sender>::template value_types<first_type, first_type>>;
+         stored_args* args = nullptr;
          
-         using following_sender = decltype(resume_via(std::declval<Scheduler>(), std::declval<stored_args>()));
+         using following_sender = decltype(resume_via(std::declval<Scheduler>(), std::declval<stored_args&>()));
          using following_operation = operation_state_type<following_sender, decayed_receiver>;
          std::optional<following_operation> follow_op;
          
          explicit operation_type(lock_mutex_sender&& wrap, Receiver&& r)
            : mutex(wrap.mutex),
-             leading_op(
-               connect(capture_args(std::move(wrap.send)), 
-                      leading_receiver{std::move(wrap.sched), std::forward<Receiver>(r), this}))
+             site(wrap.site),
+             sched(std::move(wrap.sched)),
+             recv(std::forward<Receiver>(r)),
+             leading_op(connect(capture_args(std::move(wrap.send)), leading_receiver{this}))
            {
              *wrap.save_handle = this;
            }
@@ -82,11 +121,43 @@ struct lock_mutex_sender
          {
             return std::move(leading_op).start();
          }
+
+         void lock(stored_args& captured)
+         {
+            args = &captured;
+            probe.enqueuing(site);
+            if (!mutex->enqueue(this))
+              return;
+
+            // the lock was acquired without waiting: if we are already running
+            // on the scheduler, continue inline instead of rescheduling
+            if (on_same_worker(sched))
+              return resume_inline();
+            resume();
+         }
          
          void run() && override
          {
+           probe.handed_over();
+           resume();
+         }
+
+      private:
+         // run() is invoked by the thread releasing the mutex, that must not
+         // be the only one able to resume us
+         void resume()
+         {
+           follow_op.emplace(init_from_invoke{[this] {
+              return connect(resume_via(handoff_scheduler(sched), *args), std::move(recv));
+           }});
            std::move(*follow_op).start();
          }
+
+         void resume_inline()
+         {
+           resume_via_visitor<decayed_receiver> visitor(std::move(recv));
+           args->visit(visitor);
+         }
       };
       
       return operation_type(std::move(wrap), std::forward<Receiver>(r));
@@ -115,18 +186,11 @@ struct unlock_mutex_receiver
    }
    
    template<typename... Args>
+     requires receiver_of<Receiver, Args...>
    void set_value(Args&&... args) &&
    {
       unlock();
-      
-      try
-      {
-        std::move(recv).set_value(std::forward<Args>(args)...);
-      }
-      catch(...)
-      {
-        std::move(recv).set_error(std::current_exception());
-      }
+      set_value_or_error(std::move(recv), std::forward<Args>(args)...);
    }
    
    template<typename Arg>
@@ -141,22 +205,36 @@ struct unlock_mutex_receiver
       unlock();
       std::move(recv).set_done();
    }
+
+   auto get_allocator() const
+     requires receiver_with_allocator<Receiver>
+   {
+      return recv.get_allocator();
+   }
 };
 
+template<sender_with_scheduler Sender>
+using scheduler_of_t = std::remove_cvref_t<decltype(std::declval<Sender const&>().scheduler())>;
+
+template<typed_sender Sender>
+  requires sender_with_scheduler<Sender>
+using locking_sender_t = lock_mutex_sender<Sender, scheduler_of_t<Sender>>;
+
 template<typed_sender Sender, typename Work>
-  requires std::invocable<Work, Sender> && sender_with_scheduler<Sender>
+  requires sender_with_scheduler<Sender> && std::invocable<Work, locking_sender_t<Sender>>
 struct lock_sender
 {
    Sender send;
    Work work;
    async_mutex* mutex;
+   [[no_unique_address]] lock_call_site site;
    
    template<typename Receiver>
-     requires sender_to<std::invoke_result_t<Work, Sender>, Receiver>
+     requires sender_to<std::invoke_result_t<Work, locking_sender_t<Sender>>,
+                        unlock_mutex_receiver<std::remove_cvref_t<Receiver>>>
    friend auto connect(lock_sender wrap, Receiver&& recv)
    {
-      using scheduler_type = std::remove_cvref_t<decltype(wrap.scheduler())>;
-      using locking_sender = lock_mutex_sender<Sender, scheduler_type>;
+      using locking_sender = locking_sender_t<Sender>;
       using nested_sender = std::invoke_result_t<Work, locking_sender>;
    
       using decayed_receiver = std::remove_cvref_t<Receiver>;
@@ -173,7 +251,7 @@ struct lock_sender
           : handle(nullptr),
             nested_op(connect(
               std::invoke(std::move(wrap.work), 
-                          locking_sender{std::move(wrap.send), wrap.scheduler(), wrap.mutex, &handle}),
+                          locking_sender{{}, std::move(wrap.send), wrap.scheduler(), wrap.mutex, &handle, wrap.site}),
                           nested_receiver{std::forward<Receiver>(r), wrap.mutex, &handle}))
         {}
            
@@ -195,8 +273,270 @@ struct lock_sender
 
 };
 
+// The call site is recorded by contention_profiler, if CRITICAL_SECTION_PROFILE_CONTENTION is defined.
 template<typed_sender Sender, typename Work>
-lock_sender<std::remove_cvref_t<Sender>, std::remove_cvref_t<Work>> locked(Sender&& s, Work&& w, async_mutex& m)
+lock_sender<std::remove_cvref_t<Sender>, std::remove_cvref_t<Work>>
+locked(Sender&& s, Work&& w, async_mutex& m, std::source_location loc = std::source_location::current())
+{
+   return {std::forward<Sender>(s), std::forward<Work>(w), &m, lock_call_site(loc)};
+}
+
+// Mutexes locked by a single locked() call, in the address order.
+template<std::size_t N>
+struct multi_lock_state
+{
+   std::array<async_mutex*, N> mutexes;
+   // number of distinct mutexes
+   std::size_t count;
+   // waiters of the locking operation, one per mutex
+   std::array<handle_base*, N> handles{};
+};
+
+template<typename Operation>
+struct multi_lock_slot : handle_base
+{
+   Operation* op = nullptr;
+
+   void run() && override
+   {
+      op->handed_over(this);
+   }
+};
+
+// Acquires the mutexes one by one, in the address order, so concurrent
+// callers cannot deadlock; resumes on the scheduler once all are held.
+template<typed_sender Sender, scheduler Scheduler, std::size_t N>
+struct multi_lock_mutex_sender : resumed_sender_types<Sender, Scheduler>
+{
+   Sender send;
+   Scheduler sched;
+   multi_lock_state<N>* state;
+   [[no_unique_address]] lock_call_site site;
+
+   template<typename Receiver>
+     requires receiver_for<Receiver, Sender>
+   friend auto connect(multi_lock_mutex_sender wrap, Receiver&& r)
+   {
+      using decayed_receiver = std::remove_cvref_t<Receiver>;
+
+      struct operation_type
+      {
+         multi_lock_state<N>* state;
+         [[no_unique_address]] lock_call_site site;
+         [[no_unique_address]] contention_probe probe;
+         bool contended = false;
+         Scheduler sched;
+         decayed_receiver recv;
+         std::array<multi_lock_slot<operation_type>, N> slots;
+
+         using leading_sender = decltype(capture_args(std::move(send)));
+         using leading_receiver = lock_mutex_receiver<operation_type>;
+         using leading_operation = operation_state_type<leading_sender, leading_receiver>;
+         leading_operation leading_op;
+
+         using stored_args = std::remove_reference_t<
+           typename sender_traits<leading_sender>::template value_types<first_type, first_type>>;
+         stored_args* args = nullptr;
+
+         using following_sender = decltype(resume_via(std::declval<Scheduler>(), std::declval<stored_args&>()));
+         using following_operation = operation_state_type<following_sender, decayed_receiver>;
+         std::optional<following_operation> follow_op;
+
+         explicit operation_type(multi_lock_mutex_sender&& wrap, Receiver&& r)
+           : state(wrap.state),
+             site(wrap.site),
+             sched(std::move(wrap.sched)),
+             recv(std::forward<Receiver>(r)),
+             leading_op(connect(capture_args(std::move(wrap.send)), leading_receiver{this}))
+         {
+            for (std::size_t i = 0; i < N; ++i)
+            {
+               slots[i].op = this;
+               state->handles[i] = &slots[i];
+            }
+         }
+         operation_type(operation_type&& other) = delete;
+
+         void start() &&
+         {
+            return std::move(leading_op).start();
+         }
+
+         void lock(stored_args& captured)
+         {
+            args = &captured;
+            probe.enqueuing(site);
+            acquire_from(0);
+         }
+
+         // Invoked by async_mutex::deque, once the mutex of the slot is granted.
+         void handed_over(multi_lock_slot<operation_type>* slot)
+         {
+            contended = true;
+            acquire_from(static_cast<std::size_t>(slot - slots.data()) + 1);
+         }
+
+      private:
+         void acquire_from(std::size_t i)
+         {
+            for (; i < state->count; ++i)
+              if (!state->mutexes[i]->enqueue(&slots[i]))
+                return;
+
+            if (contended)
+            {
+               probe.handed_over();
+               return resume();
+            }
+            if (on_same_worker(sched))
+              return resume_inline();
+            resume();
+         }
+
+         void resume()
+         {
+           follow_op.emplace(init_from_invoke{[this] {
+              return connect(resume_via(handoff_scheduler(sched), *args), std::move(recv));
+           }});
+           std::move(*follow_op).start();
+         }
+
+         void resume_inline()
+         {
+           resume_via_visitor<decayed_receiver> visitor(std::move(recv));
+           args->visit(visitor);
+         }
+      };
+
+      return operation_type(std::move(wrap), std::forward<Receiver>(r));
+   }
+
+   auto scheduler() const
+   {
+      return sched;
+   }
+};
+
+template<receiver Receiver, std::size_t N>
+struct multi_unlock_mutex_receiver
+{
+   Receiver recv;
+   multi_lock_state<N>* state;
+
+   void unlock()
+   {
+      for (std::size_t i = state->count; i-- > 0;)
+      {
+         handle_base* next = state->mutexes[i]->deque(state->handles[i]);
+         if (next)
+           std::move(*next).run();
+      }
+   }
+
+   template<typename... Args>
+     requires receiver_of<Receiver, Args...>
+   void set_value(Args&&... args) &&
+   {
+      unlock();
+      set_value_or_error(std::move(recv), std::forward<Args>(args)...);
+   }
+
+   template<typename Arg>
+   void set_error(Arg&& arg) && noexcept
+   {
+      unlock();
+      std::move(recv).set_error(std::forward<Arg>(arg));
+   }
+
+   void set_done() && noexcept
+   {
+      unlock();
+      std::move(recv).set_done();
+   }
+
+   auto get_allocator() const
+     requires receiver_with_allocator<Receiver>
+   {
+      return recv.get_allocator();
+   }
+};
+
+template<typed_sender Sender, std::size_t N>
+  requires sender_with_scheduler<Sender>
+using multi_locking_sender_t = multi_lock_mutex_sender<Sender, scheduler_of_t<Sender>, N>;
+
+template<typed_sender Sender, typename Work, std::size_t N>
+  requires sender_with_scheduler<Sender> && std::invocable<Work, multi_locking_sender_t<Sender, N>>
+struct multi_lock_sender
+{
+   Sender send;
+   Work work;
+   multi_lock_state<N> state;
+   [[no_unique_address]] lock_call_site site;
+
+   template<typename Receiver>
+     requires sender_to<std::invoke_result_t<Work, multi_locking_sender_t<Sender, N>>,
+                        multi_unlock_mutex_receiver<std::remove_cvref_t<Receiver>, N>>
+   friend auto connect(multi_lock_sender wrap, Receiver&& recv)
+   {
+      using locking_sender = multi_locking_sender_t<Sender, N>;
+      using nested_sender = std::invoke_result_t<Work, locking_sender>;
+
+      using decayed_receiver = std::remove_cvref_t<Receiver>;
+      using nested_receiver = multi_unlock_mutex_receiver<decayed_receiver, N>;
+
+      using nested_operation = operation_state_type<nested_sender, nested_receiver>;
+
+      struct operation_type
+      {
+         multi_lock_state<N> state;
+         nested_operation nested_op;
+
+        explicit operation_type(multi_lock_sender&& wrap, Receiver&& r)
+          : state(wrap.state),
+            nested_op(connect(
+              std::invoke(std::move(wrap.work),
+                          locking_sender{{}, std::move(wrap.send), wrap.scheduler(), &state, wrap.site}),
+                          nested_receiver{std::forward<Receiver>(r), &state}))
+        {}
+
+        operation_type(operation_type&& other) = delete;
+
+        void start() &&
+        {
+           std::move(nested_op).start();
+        }
+      };
+
+      return operation_type(std::move(wrap), std::forward<Receiver>(recv));
+   }
+
+   auto scheduler() const
+   {
+      return send.scheduler();
+   }
+};
+
+// First mutex argument of the multi-mutex locked(); records the call site,
+// as a defaulted std::source_location cannot follow the pack of mutexes.
+struct located_mutex
+{
+   async_mutex& mutex;
+   std::source_location location;
+
+   located_mutex(async_mutex& m, std::source_location loc = std::source_location::current())
+     : mutex(m), location(loc)
+   {}
+};
+
+// Locks all given mutexes (a mutex passed more than once is locked once).
+template<typed_sender Sender, typename Work, std::same_as<async_mutex>... Mutexes>
+multi_lock_sender<std::remove_cvref_t<Sender>, std::remove_cvref_t<Work>, sizeof...(Mutexes) + 2>
+locked(Sender&& s, Work&& w, located_mutex first, async_mutex& second, Mutexes&... rest)
 {
-   return {std::forward<Sender>(s), std::forward<Work>(w), &m};
+   constexpr std::size_t N = sizeof...(Mutexes) + 2;
+   multi_lock_state<N> state{{&first.mutex, &second, &rest...}, N};
+   std::sort(state.mutexes.begin(), state.mutexes.end(), std::less<async_mutex*>());
+   state.count = static_cast<std::size_t>(std::unique(state.mutexes.begin(), state.mutexes.end()) - state.mutexes.begin());
+   return {std::forward<Sender>(s), std::forward<Work>(w), state, lock_call_site(first.location)};
 }
@@ -0,0 +1,271 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#ifndef GODBOLT_COMPATIBLE
+#pragma once
+#include "concepts.hpp"
+#include "thread_pool.hpp"
+#endif // GODBOLT_COMPATIBLE
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <random>
+#include <utility>
+
+// Execution context driven by the caller: scheduled work is queued until
+// run_one(), run_random() or run_at() is invoked, so interleavings of
+// operations are reproducible. Timed work waits for the virtual clock,
+// that moves only with advance_by() and advance_to().
+// Not thread-safe; all members must be invoked from a single thread.
+class manual_context
+{
+public:
+    using duration = std::chrono::nanoseconds;
+    // time elapsed on the virtual clock since the construction
+    using time_point = std::chrono::nanoseconds;
+
+    struct scheduler_type;
+    struct sender_type;
+    struct timed_sender_type;
+
+    explicit manual_context(std::uint64_t seed = 0)
+      : random(seed)
+    {}
+
+    manual_context(manual_context&&) = delete;
+
+    scheduler_type scheduler();
+
+    std::size_t ready_count() const
+    {
+        return ready.size();
+    }
+
+    std::size_t timed_count() const
+    {
+        return timed.size();
+    }
+
+    time_point now() const
+    {
+        return current;
+    }
+
+    // Runs the oldest ready task; returns false if there is none.
+    bool run_one()
+    {
+        return run_at(0);
+    }
+
+    // Runs the index-th oldest ready task; returns false if there is none.
+    // Allows to explore all interleavings of the ready tasks.
+    bool run_at(std::size_t index)
+    {
+        if (index >= ready.size())
+          return false;
+
+        void_invocable task = std::move(ready[index]);
+        ready.erase(ready.begin() + static_cast<std::ptrdiff_t>(index));
+        std::move(task)();
+        return true;
+    }
+
+    // Runs a ready task chosen by the generator seeded in the constructor.
+    bool run_random()
+    {
+        if (ready.empty())
+          return false;
+
+        std::uniform_int_distribution<std::size_t> pick(0, ready.size() - 1);
+        return run_at(pick(random));
+    }
+
+    // Runs ready tasks, including ones scheduled by them, until there are
+    // none left; returns the number of the tasks run.
+    std::size_t run_all()
+    {
+        std::size_t count = 0;
+        while (run_one())
+          ++count;
+        return count;
+    }
+
+    std::size_t run_all_random()
+    {
+        std::size_t count = 0;
+        while (run_random())
+          ++count;
+        return count;
+    }
+
+    // Moves the virtual clock, making timed tasks due at or before the new
+    // time ready, in the order of their deadlines. Tasks are not run.
+    void advance_to(time_point t)
+    {
+        if (t > current)
+          current = t;
+
+        auto due = timed.upper_bound(current);
+        for (auto it = timed.begin(); it != due; ++it)
+          ready.push_back(std::move(it->second));
+        timed.erase(timed.begin(), due);
+    }
+
+    void advance_by(duration d)
+    {
+        advance_to(current + d);
+    }
+
+    void enque(void_invocable f)
+    {
+        ready.push_back(std::move(f));
+    }
+
+    void enque_at(time_point t, void_invocable f)
+    {
+        if (t <= current)
+          return enque(std::move(f));
+        // equal deadlines are kept in the scheduling order
+        timed.emplace(t, std::move(f));
+    }
+
+private:
+    std::deque<void_invocable> ready;
+    std::multimap<time_point, void_invocable> timed;
+    time_point current{0};
+    std::mt19937_64 random;
+};
+
+struct manual_context::sender_type
+{
+   template<template<class...> class Tuple, template<class...> class Variant>
+     using value_types = Variant<Tuple<>>;
+   template<template<class...> class Variant>
+     using error_types = set_value_error_types<Variant>;
+   static constexpr bool sends_done = false;
+
+   explicit sender_type(manual_context& c)
+     : context(&c)
+   {}
+
+   template<typename Receiver>
+     requires receiver_of<Receiver>
+   friend auto connect(sender_type s, Receiver&& r)
+   {
+      struct operation_type
+      {
+         void_invocable val;
+         manual_context* context;
+
+         void start() && {
+             context->enque(std::move(val));
+         }
+      };
+
+      return operation_type{to_void_invocable(std::forward<Receiver>(r)), s.context};
+   }
+
+   manual_context::scheduler_type scheduler() const;
+
+private:
+   manual_context* context;
+};
+
+// Completes once the virtual clock reaches the deadline. A relative deadline
+// (schedule_after) is resolved against the clock in start(), not when the
+// sender is created.
+struct manual_context::timed_sender_type
+{
+   template<template<class...> class Tuple, template<class...> class Variant>
+     using value_types = Variant<Tuple<>>;
+   template<template<class...> class Variant>
+     using error_types = set_value_error_types<Variant>;
+   static constexpr bool sends_done = false;
+
+   // if is_relative, t is the offset from the start
+   explicit timed_sender_type(manual_context& c, time_point t, bool is_relative = false)
+     : context(&c), deadline(t), relative(is_relative)
+   {}
+
+   template<typename Receiver>
+     requires receiver_of<Receiver>
+   friend auto connect(timed_sender_type s, Receiver&& r)
+   {
+      struct operation_type
+      {
+         void_invocable val;
+         manual_context* context;
+         time_point deadline;
+         bool relative;
+
+         void start() && {
+             time_point t = relative ? context->now() + deadline : deadline;
+             context->enque_at(t, std::move(val));
+         }
+      };
+
+      return operation_type{to_void_invocable(std::forward<Receiver>(r)), s.context, s.deadline, s.relative};
+   }
+
+   manual_context::scheduler_type scheduler() const;
+
+private:
+   manual_context* context;
+   time_point deadline;
+   bool relative;
+};
+
+struct manual_context::scheduler_type
+{
+   explicit scheduler_type(manual_context& c)
+     : context(&c)
+   {}
+
+   manual_context::sender_type schedule() const
+   {
+      return manual_context::sender_type(*context);
+   }
+
+   manual_context::timed_sender_type schedule_at(time_point t) const
+   {
+      return manual_context::timed_sender_type(*context, t);
+   }
+
+   manual_context::timed_sender_type schedule_after(duration d) const
+   {
+      return manual_context::timed_sender_type(*context, d, true);
+   }
+
+   time_point now() const
+   {
+      return context->now();
+   }
+
+private:
+   manual_context* context;
+};
+
+inline manual_context::scheduler_type manual_context::scheduler()
+{
+    return scheduler_type(*this);
+}
+
+inline manual_context::scheduler_type manual_context::sender_type::scheduler() const
+{
+   return manual_context::scheduler_type(*context);
+}
+
+inline manual_context::scheduler_type manual_context::timed_sender_type::scheduler() const
+{
+   return manual_context::scheduler_type(*context);
+}
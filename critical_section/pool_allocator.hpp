@@ -0,0 +1,309 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#ifndef GODBOLT_COMPATIBLE
+#pragma once
+#include "concepts.hpp"
+#endif // GODBOLT_COMPATIBLE
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+struct pool_block
+{
+   pool_block* next;
+};
+
+struct pool_allocation_stats
+{
+   // allocations served by the operator new
+   std::size_t upstream_allocations;
+   std::size_t upstream_bytes;
+   // allocations served by the pool on the calling thread
+   std::size_t thread_allocations;
+};
+
+// Allocates blocks of power-of-two sizes from 16 to 512 bytes. Each thread
+// keeps a free list per size class; surplus blocks are moved to a shared
+// depot in batches, so blocks allocated on one thread and freed on other
+// (like tasks of thread_pool) are recycled without touching malloc.
+// Memory is requested from the operator new in slabs, that are kept until
+// the end of the program.
+class pool_resource
+{
+public:
+   static constexpr std::size_t min_block = 16;
+   static constexpr std::size_t max_block = 512;
+   static constexpr std::size_t class_count = 6;
+   static constexpr std::size_t batch_size = 32;
+
+   static void* allocate(std::size_t bytes, std::size_t align = alignof(std::max_align_t))
+   {
+      if (bytes > max_block || align > alignof(std::max_align_t))
+      {
+         count_upstream(bytes);
+         return ::operator new(bytes, std::align_val_t(align));
+      }
+
+      thread_block_cache* cache = thread_cache();
+      if (!cache)
+        return allocate_uncached(size_class(bytes));
+      ++cache->allocations;
+      return cache->allocate(size_class(bytes));
+   }
+
+   static void deallocate(void* p, std::size_t bytes, std::size_t align = alignof(std::max_align_t)) noexcept
+   {
+      if (bytes > max_block || align > alignof(std::max_align_t))
+        return ::operator delete(p, std::align_val_t(align));
+
+      thread_block_cache* cache = thread_cache();
+      if (!cache)
+        return deallocate_uncached(p, size_class(bytes));
+      cache->deallocate(p, size_class(bytes));
+   }
+
+   static pool_allocation_stats stats()
+   {
+      thread_block_cache* cache = thread_cache();
+      return {upstream().allocations.load(std::memory_order_relaxed),
+              upstream().bytes.load(std::memory_order_relaxed),
+              cache ? cache->allocations : 0};
+   }
+
+private:
+   static std::size_t size_class(std::size_t bytes)
+   {
+      std::size_t cls = 0;
+      for (std::size_t size = min_block; size < bytes; size <<= 1)
+        ++cls;
+      return cls;
+   }
+
+   static std::size_t class_size(std::size_t cls)
+   {
+      return min_block << cls;
+   }
+
+   struct upstream_counters
+   {
+      std::atomic<std::size_t> allocations{0};
+      std::atomic<std::size_t> bytes{0};
+   };
+
+   static upstream_counters& upstream()
+   {
+      static upstream_counters counters;
+      return counters;
+   }
+
+   static void count_upstream(std::size_t bytes)
+   {
+      upstream().allocations.fetch_add(1, std::memory_order_relaxed);
+      upstream().bytes.fetch_add(bytes, std::memory_order_relaxed);
+   }
+
+   struct depot
+   {
+      std::mutex m;
+      pool_block* head = nullptr;
+
+      // Returns a list of batch_size blocks.
+      pool_block* take(std::size_t block_size)
+      {
+         {
+           std::lock_guard<std::mutex> lock(m);
+           if (head)
+           {
+              pool_block* first = head;
+              pool_block* last = first;
+              for (std::size_t i = 1; i < batch_size && last->next; ++i)
+                last = last->next;
+              head = last->next;
+              last->next = nullptr;
+              return first;
+           }
+         }
+
+         count_upstream(block_size * batch_size);
+         auto* slab = static_cast<std::byte*>(::operator new(block_size * batch_size));
+         pool_block* first = nullptr;
+         for (std::size_t i = batch_size; i-- > 0;)
+         {
+            auto* block = reinterpret_cast<pool_block*>(slab + i * block_size);
+            block->next = first;
+            first = block;
+         }
+         return first;
+      }
+
+      void put(pool_block* first, pool_block* last)
+      {
+         std::lock_guard<std::mutex> lock(m);
+         last->next = head;
+         head = first;
+      }
+   };
+
+   static std::array<depot, class_count>& depots()
+   {
+      static std::array<depot, class_count> instance;
+      return instance;
+   }
+
+   struct thread_block_cache
+   {
+      struct free_list
+      {
+         pool_block* head = nullptr;
+         std::size_t count = 0;
+      };
+
+      std::array<free_list, class_count> lists;
+      std::size_t allocations = 0;
+
+      thread_block_cache()
+      {
+         // ensure depots outlive the caches of all threads
+         depots();
+      }
+
+      thread_block_cache(thread_block_cache&&) = delete;
+
+      ~thread_block_cache()
+      {
+         for (std::size_t cls = 0; cls < class_count; ++cls)
+         {
+            free_list& list = lists[cls];
+            if (!list.head)
+              continue;
+            pool_block* last = list.head;
+            while (last->next)
+              last = last->next;
+            depots()[cls].put(list.head, last);
+            list.head = nullptr;
+            list.count = 0;
+         }
+         cache_destroyed = true;
+      }
+
+      void* allocate(std::size_t cls)
+      {
+         free_list& list = lists[cls];
+         if (!list.head)
+         {
+            list.head = depots()[cls].take(class_size(cls));
+            list.count = 0;
+            for (pool_block* b = list.head; b; b = b->next)
+              ++list.count;
+         }
+
+         pool_block* block = list.head;
+         list.head = block->next;
+         --list.count;
+         return block;
+      }
+
+      void deallocate(void* p, std::size_t cls)
+      {
+         free_list& list = lists[cls];
+         auto* block = static_cast<pool_block*>(p);
+         block->next = list.head;
+         list.head = block;
+         if (++list.count < 2 * batch_size)
+           return;
+
+         // return the oldest batch_size blocks to the depot
+         pool_block* last = list.head;
+         for (std::size_t i = 1; i < batch_size; ++i)
+           last = last->next;
+         depots()[cls].put(last->next, tail_of(last->next));
+         last->next = nullptr;
+         list.count = batch_size;
+      }
+
+      static pool_block* tail_of(pool_block* b)
+      {
+         while (b->next)
+           b = b->next;
+         return b;
+      }
+   };
+
+   // Set once the cache of the thread is destroyed; blocks allocated or
+   // freed by the destructors of thread_local objects that run later
+   // bypass the cache.
+   static inline thread_local bool cache_destroyed = false;
+
+   static thread_block_cache* thread_cache()
+   {
+      if (cache_destroyed)
+        return nullptr;
+      thread_local thread_block_cache cache;
+      return &cache;
+   }
+
+   static void* allocate_uncached(std::size_t cls)
+   {
+      // the block joins the pool once it is freed
+      count_upstream(class_size(cls));
+      return ::operator new(class_size(cls));
+   }
+
+   static void deallocate_uncached(void* p, std::size_t cls) noexcept
+   {
+      auto* block = static_cast<pool_block*>(p);
+      depots()[cls].put(block, block);
+   }
+};
+
+// Standard allocator using the pool_resource.
+template<typename T>
+struct pool_allocator
+{
+   using value_type = T;
+
+   pool_allocator() = default;
+
+   template<typename U>
+   pool_allocator(pool_allocator<U> const&) noexcept
+   {}
+
+   T* allocate(std::size_t n)
+   {
+      return static_cast<T*>(pool_resource::allocate(n * sizeof(T), alignof(T)));
+   }
+
+   void deallocate(T* p, std::size_t n) noexcept
+   {
+      pool_resource::deallocate(p, n * sizeof(T), alignof(T));
+   }
+
+   template<typename U>
+   friend bool operator==(pool_allocator const&, pool_allocator<U> const&) noexcept
+   {
+      return true;
+   }
+};
+
+// Allocator that should be used by senders that need to heap-allocate on
+// behalf of the receiver: the result of r.get_allocator() if provided,
+// the pool_allocator otherwise.
+template<receiver Receiver>
+auto get_allocator(Receiver const& r)
+{
+   if constexpr (receiver_with_allocator<Receiver>)
+     return r.get_allocator();
+   else
+     return pool_allocator<std::byte>();
+}
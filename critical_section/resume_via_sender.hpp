@@ -20,10 +20,10 @@ struct resume_via_visitor
     Receiver&& r;
     
     template<typename... Args>
-    void operator()(received_values<Args...>& v)
+    void operator()(received_values<Args...>& v) noexcept
     {
         std::apply([&r=r](auto&&... args) {
-          std::move(r).set_value(std::forward<decltype(args)>(args)...);
+          set_value_or_error(std::move(r), std::forward<decltype(args)>(args)...);
         }, std::move(v.value));
     }
     
@@ -45,18 +45,13 @@ struct resume_via_receiver
     Receiver r;
     OpState* opState;
     
+    // The nested operation owns this receiver, and may still be in its
+    // start(), if the scheduler completes inline; it is destroyed with the
+    // enclosing operation.
     void set_value() &&
     {
-        opState->nested_operation = std::nullopt;
         resume_via_visitor<Receiver> visitor(std::move(r));
-        try
-        {
-           std::visit(visitor, *opState->store);
-        }
-        catch(...)
-        {
-           std::move(r).set_error(std::current_exception());
-        }
+        opState->store->visit(visitor);
     };
     
     template<typename Error>
@@ -68,6 +63,12 @@ struct resume_via_receiver
     void set_done() && {
       std::move(r).set_done();
     }
+
+    auto get_allocator() const
+      requires receiver_with_allocator<Receiver>
+    {
+       return r.get_allocator();
+    }
 };
 
 template<scheduler Scheduler, typename ReceivedArgs>
@@ -79,34 +80,58 @@ struct resume_via_sender
     using Sender = decltype(std::declval<Scheduler>().schedule());
     
     template<typename Receiver>
-    // ?  requires sender_to<Sender, Receiver>
+      requires receiver<Receiver>
     friend auto connect(resume_via_sender wrap, Receiver&& r)
     {
        using decayed_receiver = std::remove_cvref_t<Receiver>;
 
-       struct operation_type
+       if constexpr (is_inline_scheduler_v<Scheduler>)
+       {
+          // no thread switch can happen, deliver the stored result directly
+          struct operation_type
+          {
+             ReceivedArgs* store;
+             decayed_receiver r;
+
+             explicit operation_type(resume_via_sender&& wrap, Receiver&& r)
+               : store(wrap.store), r(std::forward<Receiver>(r))
+             {}
+
+             operation_type(operation_type&&) = delete;
+
+             void start() && {
+                resume_via_visitor<decayed_receiver> visitor(std::move(r));
+                store->visit(visitor);
+             }
+          };
+
+          return operation_type(std::move(wrap), std::forward<Receiver>(r));
+       }
+       else
        {
-          ReceivedArgs* store;
-          decayed_receiver receiver;
+          struct operation_type
+          {
+             ReceivedArgs* store;
 
-          using nested_receiver_type = resume_via_receiver<decayed_receiver, operation_type>;
-          using nested_operation_type = operation_state_type<Sender, nested_receiver_type>;
-          std::optional<nested_operation_type> nested_operation;
-        
-          explicit operation_type(resume_via_sender&& wrap, Receiver&& r)
-            : store(wrap.store), nested_operation(std::in_place, init_from_invoke{[&] { 
-               return connect(std::move(wrap.sched).schedule(), nested_receiver_type{std::forward<Receiver>(r), this});
-             }})
-          {}
-        
-          operation_type(operation_type&&) = delete;
+             using nested_receiver_type = resume_via_receiver<decayed_receiver, operation_type>;
+             using nested_operation_type = operation_state_type<Sender, nested_receiver_type>;
+             nested_operation_type nested_operation;
+           
+             explicit operation_type(resume_via_sender&& wrap, Receiver&& r)
+               : store(wrap.store), nested_operation(init_from_invoke{[&] { 
+                  return connect(std::move(wrap.sched).schedule(), nested_receiver_type{std::forward<Receiver>(r), this});
+                }})
+             {}
+           
+             operation_type(operation_type&&) = delete;
+             
+             void start() && {
+                return std::move(nested_operation).start();
+             }
+          };
           
-          void start() && {
-             return std::move(*nested_operation).start();
-          }
-       };
-       
-       return operation_type(std::move(wrap), std::forward<Receiver>(r));
+          return operation_type(std::move(wrap), std::forward<Receiver>(r));
+       }
     };
 
     Scheduler scheduler() const
@@ -0,0 +1,414 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#ifndef GODBOLT_COMPATIBLE
+#pragma once
+#include "concepts.hpp"
+#include "capture_sender.hpp"
+#include "async_mutex.hpp"
+#include "locked_sender.hpp"
+#endif // GODBOLT_COMPATIBLE
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <source_location>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+// async_mutex paired with a sequence counter, that is odd while a writer
+// holds the mutex. Writers use locked(sender, work, seqlock&); readers use
+// optimistic_locked(), that reads without locking and validates the read
+// against the counter.
+struct seqlock
+{
+   async_mutex mutex;
+   std::atomic<std::size_t> sequence{0};
+};
+
+// Increments the sequence on any completion of the nested sender: when the
+// lock is granted (Entering), and before it is released.
+template<receiver Receiver, bool Entering>
+struct seqlock_section_receiver
+{
+   Receiver recv;
+   std::atomic<std::size_t>* sequence;
+
+   void bump() noexcept
+   {
+      // entering: the acquire orders the writes to the protected data after
+      // the increment; it synchronizes with the validating readers, whose
+      // reads (if validated) therefore happen before these writes
+      if constexpr (Entering)
+        sequence->fetch_add(1, std::memory_order_acq_rel);
+      else
+        sequence->fetch_add(1, std::memory_order_release);
+   }
+
+   template<typename... Args>
+     requires receiver_of<Receiver, Args...>
+   void set_value(Args&&... args) &&
+   {
+      bump();
+      std::move(recv).set_value(std::forward<Args>(args)...);
+   }
+
+   template<typename Error>
+   void set_error(Error&& err) && noexcept
+   {
+      bump();
+      std::move(recv).set_error(std::forward<Error>(err));
+   }
+
+   void set_done() && noexcept
+   {
+      bump();
+      std::move(recv).set_done();
+   }
+
+   auto get_allocator() const
+     requires receiver_with_allocator<Receiver>
+   {
+      return recv.get_allocator();
+   }
+};
+
+template<sender Sender, bool Entering>
+struct seqlock_section_sender : forwarded_sender_types<Sender>
+{
+   Sender send;
+   std::atomic<std::size_t>* sequence;
+
+   // the values can be checked only if the sender is typed
+   template<typename Receiver>
+     requires receiver<Receiver> && (!typed_sender<Sender> || receiver_for<Receiver, Sender>)
+   friend auto connect(seqlock_section_sender s, Receiver&& r)
+   {
+      using nested_receiver = seqlock_section_receiver<std::remove_cvref_t<Receiver>, Entering>;
+      return connect(std::move(s.send), nested_receiver{std::forward<Receiver>(r), s.sequence});
+   }
+
+   auto scheduler() const
+     requires sender_with_scheduler<Sender>
+   {
+      return send.scheduler();
+   }
+};
+
+// Work of the writer: the locking sender is wrapped to mark the start of
+// the write, and the sender returned by the work to mark its end.
+template<typename Work>
+struct seqlock_writer_work
+{
+   Work work;
+   std::atomic<std::size_t>* sequence;
+
+   template<typename LockingSender>
+     requires std::invocable<Work, seqlock_section_sender<LockingSender, true>>
+   auto operator()(LockingSender s) &&
+   {
+      using entering_sender = seqlock_section_sender<LockingSender, true>;
+      using nested_sender = std::invoke_result_t<Work, entering_sender>;
+      return seqlock_section_sender<nested_sender, false>{
+        {}, std::invoke(std::move(work), entering_sender{{}, std::move(s), sequence}), sequence};
+   }
+};
+
+template<typed_sender Sender, typename Work>
+lock_sender<std::remove_cvref_t<Sender>, seqlock_writer_work<std::remove_cvref_t<Work>>>
+locked(Sender&& s, Work&& w, seqlock& l, std::source_location loc = std::source_location::current())
+{
+   return {std::forward<Sender>(s), {std::forward<Work>(w), &l.sequence}, &l.mutex, lock_call_site(loc)};
+}
+
+// Invokes the read function with the stored values, the result is returned
+// as a tuple, that is empty if the function returns void.
+template<typename ReadFn, typename... Args>
+auto invoke_read(ReadFn& fn, std::tuple<Args...>& args) noexcept
+{
+   if constexpr (std::is_void_v<std::invoke_result_t<ReadFn&, Args&...>>)
+   {
+      std::apply(fn, args);
+      return std::tuple<>();
+   }
+   else
+      return std::tuple<std::invoke_result_t<ReadFn&, Args&...>>(std::apply(fn, args));
+}
+
+// Delivers the captured result of the upstream sender: values are passed to
+// the read function, either speculatively (validated with the sequence) or
+// with the mutex held; errors and done are forwarded as is.
+template<typename Operation>
+struct optimistic_read_visitor
+{
+   Operation* op;
+   bool speculative;
+   bool completed = false;
+
+   template<typename... Args>
+   void operator()(received_values<Args...>& v) noexcept
+   {
+      static_assert(std::is_nothrow_invocable_v<decltype((op->fn)), Args&...>,
+                    "read function may observe inconsistent data and must not throw");
+
+      if (!speculative)
+      {
+         auto result = invoke_read(op->fn, v.value);
+         op->unlock();
+         return complete(std::move(result));
+      }
+
+      std::atomic<std::size_t>& sequence = op->lock->sequence;
+      for (std::size_t i = 0; i < op->attempts; ++i)
+      {
+         std::size_t before = sequence.load(std::memory_order_acquire);
+         if (before % 2 != 0)
+         {
+            // a writer holds the mutex, give it a chance to finish before
+            // the next attempt, instead of spinning through all of them
+            std::this_thread::yield();
+            continue;
+         }
+
+         auto result = invoke_read(op->fn, v.value);
+         // the release orders the reads before the validation; unlike a load,
+         // the read-modify-write cannot precede the increment of a writer
+         // whose writes were observed (see seqlock_section_receiver::bump)
+         if (sequence.fetch_add(0, std::memory_order_release) != before)
+           continue;
+
+         return complete(std::move(result));
+      }
+   }
+
+   template<typename Arg>
+   void operator()(received_error<Arg>& v) noexcept
+   {
+      if (!speculative)
+        op->unlock();
+      completed = true;
+      std::move(op->recv).set_error(std::move(v).value);
+   }
+
+   void operator()(received_done) noexcept
+   {
+      if (!speculative)
+        op->unlock();
+      completed = true;
+      std::move(op->recv).set_done();
+   }
+
+private:
+   template<typename Result>
+   void complete(Result&& result) noexcept
+   {
+      completed = true;
+      std::apply([this](auto&&... vals) {
+         set_value_or_error(std::move(op->recv), std::move(vals)...);
+      }, std::move(result));
+   }
+};
+
+template<typename Operation>
+struct optimistic_read_receiver
+{
+   Operation* op;
+
+   template<typename Arg>
+   void set_value(Arg& args)
+   {
+      op->read(args);
+   }
+
+   // capture_args() delivers errors and done as values, these are never invoked
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {
+      std::terminate();
+   }
+
+   void set_done() && noexcept
+   {
+      std::terminate();
+   }
+};
+
+// Resumes the fallback read on the scheduler, once the mutex is held.
+template<typename Operation>
+struct optimistic_resume_receiver
+{
+   Operation* op;
+
+   void set_value() &&
+   {
+      op->read_locked();
+   }
+
+   template<typename Error>
+   void set_error(Error&& err) && noexcept
+   {
+      op->unlock();
+      std::move(op->recv).set_error(std::forward<Error>(err));
+   }
+
+   void set_done() && noexcept
+   {
+      op->unlock();
+      std::move(op->recv).set_done();
+   }
+};
+
+template<template<class...> class Tuple, typename Result>
+struct optimistic_read_result
+{
+   using type = Tuple<Result>;
+};
+
+template<template<class...> class Tuple>
+struct optimistic_read_result<Tuple, void>
+{
+   using type = Tuple<>;
+};
+
+// Values returned by the read function (none if it returns void); errors
+// and done of Sender, and of the scheduler that resumes the fallback read.
+template<typed_sender Sender, typename ReadFn>
+struct optimistic_read_sender_types : resumed_sender_types<Sender, scheduler_of_t<Sender>>
+{
+   template<template<class...> class Tuple>
+   struct read_result_tuple
+   {
+      template<typename... Args>
+      using type = typename optimistic_read_result<Tuple, std::invoke_result_t<ReadFn&, Args&...>>::type;
+   };
+
+   template<template<class...> class Tuple, template<class...> class Variant>
+     using value_types = typename sender_traits<Sender>::template value_types<read_result_tuple<Tuple>::template type, Variant>;
+};
+
+template<typed_sender Sender, typename ReadFn>
+  requires sender_with_scheduler<Sender>
+struct optimistic_read_sender : optimistic_read_sender_types<Sender, ReadFn>
+{
+   Sender send;
+   ReadFn fn;
+   seqlock* lock;
+   std::size_t attempts;
+
+   template<typename Receiver>
+     requires receiver_for<Receiver, optimistic_read_sender>
+   friend auto connect(optimistic_read_sender wrap, Receiver&& r)
+   {
+      using decayed_receiver = std::remove_cvref_t<Receiver>;
+      using scheduler_type = scheduler_of_t<Sender>;
+
+      struct operation_type : handle_base
+      {
+         decayed_receiver recv;
+         ReadFn fn;
+         seqlock* lock;
+         std::size_t attempts;
+         scheduler_type sched;
+
+         using leading_sender = decltype(capture_args(std::move(send)));
+         using leading_operation = operation_state_type<leading_sender, optimistic_read_receiver<operation_type>>;
+         leading_operation leading_op;
+
+         using stored_args = std::remove_reference_t<
+           typename sender_traits<leading_sender>::template value_types<first_type, first_type>>;
+         stored_args* args = nullptr;
+
+         using resume_sender = decltype(std::declval<scheduler_type>().schedule());
+         using resume_operation = operation_state_type<resume_sender, optimistic_resume_receiver<operation_type>>;
+         std::optional<resume_operation> resume_op;
+
+         explicit operation_type(optimistic_read_sender&& wrap, Receiver&& r)
+           : recv(std::forward<Receiver>(r)),
+             fn(std::move(wrap.fn)),
+             lock(wrap.lock),
+             attempts(wrap.attempts),
+             sched(wrap.send.scheduler()),
+             leading_op(connect(capture_args(std::move(wrap.send)), optimistic_read_receiver<operation_type>{this}))
+         {}
+
+         operation_type(operation_type&&) = delete;
+
+         void start() &&
+         {
+            std::move(leading_op).start();
+         }
+
+         void read(stored_args& captured)
+         {
+            args = &captured;
+            optimistic_read_visitor<operation_type> visitor{this, true};
+            args->visit(visitor);
+            if (visitor.completed)
+              return;
+
+            // all attempts conflicted with writers, wait for the mutex
+            if (!lock->mutex.enqueue(this))
+              return;
+            if (on_same_worker(sched))
+              return read_locked();
+            resume();
+         }
+
+         void run() && override
+         {
+            resume();
+         }
+
+         void read_locked()
+         {
+            optimistic_read_visitor<operation_type> visitor{this, false};
+            args->visit(visitor);
+         }
+
+         void unlock()
+         {
+            handle_base* next = lock->mutex.deque(this);
+            if (next)
+              std::move(*next).run();
+         }
+
+      private:
+         void resume()
+         {
+            resume_op.emplace(init_from_invoke{[this] {
+               return connect(handoff_scheduler(sched).schedule(), optimistic_resume_receiver<operation_type>{this});
+            }});
+            std::move(*resume_op).start();
+         }
+      };
+
+      return operation_type(std::move(wrap), std::forward<Receiver>(r));
+   }
+
+   auto scheduler() const
+   {
+      return send.scheduler();
+   }
+};
+
+// Invokes read_fn with the values of the sender without locking, and
+// retries if a writer held the lock in the meantime; after the given
+// number of failed attempts, reads with the mutex held, like locked().
+// read_fn may observe inconsistent data (whose result is discarded), so it
+// must not throw, and should read the shared data through atomics.
+template<typed_sender Sender, typename ReadFn>
+  requires sender_with_scheduler<std::remove_cvref_t<Sender>>
+optimistic_read_sender<std::remove_cvref_t<Sender>, std::remove_cvref_t<ReadFn>>
+optimistic_locked(Sender&& s, ReadFn&& fn, seqlock& l, std::size_t attempts = 4)
+{
+   return {{}, std::forward<Sender>(s), std::forward<ReadFn>(fn), &l, attempts};
+}
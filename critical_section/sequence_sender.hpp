@@ -0,0 +1,879 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#ifndef GODBOLT_COMPATIBLE
+#pragma once
+#include "concepts.hpp"
+#include "helpers.hpp"
+#include "capture_sender.hpp"
+#endif // GODBOLT_COMPATIBLE
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Sequence senders deliver many values to a single receiver.
+//
+// Every item is passed to r.set_next(values...), that returns a sender (next-sender).
+// The producer does not emit the following item until the next-sender completes:
+//  * set_value() - request the next item,
+//  * set_done()  - stop the sequence, the producer completes with set_done(),
+//  * set_error() - stop the sequence, the producer completes with set_error().
+// When the sequence is exhausted, the receiver is completed with set_value().
+//
+// The value_types/error_types/sends_done describe a single item.
+template<typename R, typename... Args>
+concept sequence_receiver_of = receiver<R> &&
+  requires (std::remove_cvref_t<R>& r, Args&&... args) {
+    { r.set_next((Args&&) args...) } -> sender;
+  };
+
+template<typename R>
+struct sequence_receiver_of_values
+{
+   template<typename... Args>
+   using tuple = std::bool_constant<sequence_receiver_of<R, Args...>>;
+
+   template<typename... Tuples>
+   using variant = std::bool_constant<(Tuples::value && ...)>;
+};
+
+// Sequence receiver accepting every item of the typed sequence sender,
+// like receiver_for for the single-value senders.
+template<typename R, typename S>
+concept sequence_receiver_for = typed_sender<S> &&
+  sender_traits<std::remove_cvref_t<S>>::template value_types<
+    sequence_receiver_of_values<R>::template tuple, sequence_receiver_of_values<R>::template variant>::value;
+
+template<typename R, typename... Args>
+using next_sender_t = decltype(std::declval<R&>().set_next(std::declval<Args>()...));
+
+// Detects if the next-sender completed inside its start(), so the producer
+// can loop instead of recursing for every item.
+struct sequence_trampoline
+{
+   enum state_type : unsigned char { starting, completed, suspended };
+   std::atomic<unsigned char> state{starting};
+
+   void begin()
+   {
+      state.store(starting, std::memory_order_relaxed);
+   }
+
+   // Called after start(), returns true if the producer should continue.
+   bool started()
+   {
+      return state.exchange(suspended, std::memory_order_acq_rel) == completed;
+   }
+
+   // Called on completion, returns true if the producer needs to be resumed.
+   bool complete()
+   {
+      return state.exchange(completed, std::memory_order_acq_rel) == suspended;
+   }
+};
+
+// Emits items to the Receiver, one at the time; Derived::resume() is invoked
+// when the next-sender completes asynchronously.
+template<typename Derived, typename Receiver, typename... Values>
+struct sequence_emitter
+{
+   struct next_receiver
+   {
+      sequence_emitter* self;
+
+      template<typename... Args>
+      void set_value(Args&&...) &&
+      {
+         self->item_completed();
+      }
+
+      template<typename Error>
+      void set_error(Error&& err) && noexcept
+      {
+         if constexpr (std::is_same_v<std::remove_cvref_t<Error>, std::exception_ptr>)
+           self->error = std::forward<Error>(err);
+         else
+           self->error = std::make_exception_ptr(std::forward<Error>(err));
+         self->stopped = true;
+         self->item_completed();
+      }
+
+      void set_done() && noexcept
+      {
+         self->stopped = true;
+         self->item_completed();
+      }
+   };
+
+   using next_sender = next_sender_t<Receiver, Values...>;
+   using next_operation = operation_state_type<next_sender, next_receiver>;
+
+   std::optional<next_operation> next_op;
+   sequence_trampoline trampoline;
+   std::exception_ptr error;
+   bool stopped = false;
+
+   // Returns true if item was consumed synchronously and next one can be emitted.
+   template<typename... Args>
+   bool emit(Receiver& r, Args&&... args)
+   {
+      trampoline.begin();
+      next_op.emplace(init_from_invoke{[&] {
+         return connect(r.set_next(std::forward<Args>(args)...), next_receiver{this});
+      }});
+      std::move(*next_op).start();
+      return trampoline.started();
+   }
+
+   void item_completed()
+   {
+      if (trampoline.complete())
+        static_cast<Derived*>(this)->resume();
+   }
+
+   template<typename R>
+   void finish(R&& r)
+   {
+      next_op.reset();
+      if (error)
+        std::forward<R>(r).set_error(std::move(error));
+      else if (stopped)
+        std::forward<R>(r).set_done();
+      else
+        std::forward<R>(r).set_value();
+   }
+};
+
+// Sequence of integers [first, last), produced on the thread that starts it.
+template<std::integral Integer>
+struct iota_sequence_sender
+{
+    Integer first;
+    Integer last;
+
+    template<template<class...> class Tuple, template<class...> class Variant>
+      using value_types = Variant<Tuple<Integer>>;
+    template<template<class...> class Variant>
+      using error_types = Variant<std::exception_ptr>;
+    static constexpr bool sends_done = true;
+
+    template<typename Receiver>
+      requires sequence_receiver_of<Receiver, Integer>
+    friend auto connect(iota_sequence_sender s, Receiver&& r)
+    {
+       using decayed_receiver = std::remove_cvref_t<Receiver>;
+
+       struct operation_type : sequence_emitter<operation_type, decayed_receiver, Integer>
+       {
+          decayed_receiver r;
+          Integer current;
+          Integer last;
+
+          explicit operation_type(iota_sequence_sender&& s, Receiver&& r)
+            : r(std::forward<Receiver>(r)), current(s.first), last(s.last)
+          {}
+
+          operation_type(operation_type&&) = delete;
+
+          void start() &&
+          {
+             resume();
+          }
+
+          void resume()
+          {
+             while (!this->stopped && current != last)
+               if (!this->emit(r, current++))
+                 return;
+
+             this->finish(std::move(r));
+          }
+       };
+
+       return operation_type(std::move(s), std::forward<Receiver>(r));
+    }
+
+    inline_scheduler scheduler() const
+    {
+      return {};
+    }
+};
+
+template<std::integral Integer>
+iota_sequence_sender<Integer> iota_sequence(Integer first, Integer last)
+{
+  return {first, last};
+}
+
+// Single item of the sequence, passed to the for_each callback.
+template<scheduler Scheduler, typename... Values>
+struct sequence_item_sender
+{
+    Scheduler sched;
+    std::tuple<Values...> values;
+
+    template<template<class...> class Tuple, template<class...> class Variant>
+      using value_types = Variant<Tuple<Values...>>;
+    template<template<class...> class Variant>
+      using error_types = set_value_error_types<Variant>;
+    static constexpr bool sends_done = false;
+
+    template<typename Receiver>
+      requires receiver_of<Receiver, Values...>
+    friend auto connect(sequence_item_sender s, Receiver&& r)
+    {
+       struct operation
+       {
+          std::remove_cvref_t<Receiver> r;
+          std::tuple<Values...> values;
+
+          void start() &&
+          {
+             std::apply([this](Values&... vals) {
+               set_value_or_error(std::move(r), std::move(vals)...);
+             }, values);
+          }
+       };
+
+       return operation{std::forward<Receiver>(r), std::move(s.values)};
+    }
+
+    Scheduler scheduler() const
+    {
+      return sched;
+    }
+};
+
+template<receiver Receiver, typename Fn, scheduler Scheduler>
+struct for_each_receiver
+{
+   Receiver r;
+   Fn fn;
+   Scheduler sched;
+
+   template<typename... Args>
+   auto set_next(Args&&... args)
+   {
+      using item_sender = sequence_item_sender<Scheduler, std::remove_cvref_t<Args>...>;
+      return std::invoke(fn, item_sender{sched, {std::forward<Args>(args)...}});
+   }
+
+   void set_value() &&
+   {
+      std::move(r).set_value();
+   }
+
+   template<typename Error>
+   void set_error(Error&& err) && noexcept
+   {
+      std::move(r).set_error(std::forward<Error>(err));
+   }
+
+   void set_done() && noexcept
+   {
+      std::move(r).set_done();
+   }
+};
+
+// Invokes fn with a sender of each item and waits for the returned sender
+// before requesting the next one; completes with set_value() when the
+// sequence is exhausted.
+template<typed_sender Sequence, typename Fn>
+  requires sender_with_scheduler<Sequence>
+struct for_each_sender
+{
+    Sequence seq;
+    Fn fn;
+
+    // errors of the sequence, and of the senders returned by fn
+    template<template<class...> class Tuple, template<class...> class Variant>
+      using value_types = Variant<Tuple<>>;
+    template<template<class...> class Variant>
+      using error_types = typename concat_type_lists<
+        Variant,
+        typename sender_traits<Sequence>::template error_types<type_list>,
+        type_list<std::exception_ptr>>::type;
+    static constexpr bool sends_done = true;
+
+    template<typename Receiver>
+      requires receiver_for<Receiver, for_each_sender>
+    friend auto connect(for_each_sender s, Receiver&& r)
+    {
+       using scheduler_type = std::remove_cvref_t<decltype(s.seq.scheduler())>;
+       using nested_receiver = for_each_receiver<std::remove_cvref_t<Receiver>, Fn, scheduler_type>;
+       auto sched = s.seq.scheduler();
+       return connect(std::move(s.seq), nested_receiver{std::forward<Receiver>(r), std::move(s.fn), std::move(sched)});
+    }
+
+    auto scheduler() const
+    {
+      return seq.scheduler();
+    }
+};
+
+template<typed_sender Sequence, typename Fn>
+for_each_sender<std::remove_cvref_t<Sequence>, std::remove_cvref_t<Fn>> for_each(Sequence&& seq, Fn&& fn)
+{
+  return {std::forward<Sequence>(seq), std::forward<Fn>(fn)};
+}
+
+template<receiver Receiver, typename Fn>
+struct transform_receiver
+{
+   Receiver r;
+   Fn fn;
+
+   template<typename... Args>
+   auto set_next(Args&&... args)
+   {
+      return r.set_next(std::invoke(fn, std::forward<Args>(args)...));
+   }
+
+   void set_value() &&
+   {
+      std::move(r).set_value();
+   }
+
+   template<typename Error>
+   void set_error(Error&& err) && noexcept
+   {
+      std::move(r).set_error(std::forward<Error>(err));
+   }
+
+   void set_done() && noexcept
+   {
+      std::move(r).set_done();
+   }
+};
+
+template<typed_sender Sequence, typename Fn>
+struct transform_sender : then_sender_types<Sequence, Fn>
+{
+    Sequence seq;
+    Fn fn;
+
+    template<typename Receiver>
+      requires sequence_receiver_for<Receiver, transform_sender>
+    friend auto connect(transform_sender s, Receiver&& r)
+    {
+       using nested_receiver = transform_receiver<std::remove_cvref_t<Receiver>, Fn>;
+       return connect(std::move(s.seq), nested_receiver{std::forward<Receiver>(r), std::move(s.fn)});
+    }
+
+    auto scheduler() const
+      requires sender_with_scheduler<Sequence>
+    {
+      return seq.scheduler();
+    }
+};
+
+template<typed_sender Sequence, typename Fn>
+transform_sender<std::remove_cvref_t<Sequence>, std::remove_cvref_t<Fn>> transform(Sequence&& seq, Fn&& fn)
+{
+  return {{}, std::forward<Sequence>(seq), std::forward<Fn>(fn)};
+}
+
+// Next-sender of take: forwards the downstream next-sender, and stops
+// the producer after the last item.
+template<sender NextSender, typename Exhausted>
+struct take_next_sender
+{
+    std::optional<NextSender> next;
+    Exhausted* exhausted;
+
+    template<receiver Receiver>
+    struct last_item_receiver
+    {
+       Receiver r;
+       bool last;
+
+       template<typename... Args>
+       void set_value(Args&&... args) &&
+       {
+          if (last)
+            std::move(r).set_done();
+          else
+            std::move(r).set_value(std::forward<Args>(args)...);
+       }
+
+       template<typename Error>
+       void set_error(Error&& err) && noexcept
+       {
+          std::move(r).set_error(std::forward<Error>(err));
+       }
+
+       void set_done() && noexcept
+       {
+          std::move(r).set_done();
+       }
+    };
+
+    template<typename Receiver>
+    friend auto connect(take_next_sender s, Receiver&& r)
+    {
+       using decayed_receiver = std::remove_cvref_t<Receiver>;
+       using nested_receiver = last_item_receiver<decayed_receiver>;
+       using nested_operation = operation_state_type<NextSender, nested_receiver>;
+
+       struct operation_type
+       {
+          std::optional<decayed_receiver> r;
+          std::optional<nested_operation> nested_op;
+
+          explicit operation_type(take_next_sender&& s, Receiver&& r)
+          {
+             if (!s.next)
+             {
+               this->r.emplace(std::forward<Receiver>(r));
+               return;
+             }
+
+             nested_op.emplace(init_from_invoke{[&] {
+               return connect(std::move(*s.next), nested_receiver{std::forward<Receiver>(r), *s.exhausted});
+             }});
+          }
+
+          operation_type(operation_type&&) = delete;
+
+          void start() &&
+          {
+             if (nested_op)
+               std::move(*nested_op).start();
+             else
+               std::move(*r).set_done();
+          }
+       };
+
+       return operation_type(std::move(s), std::forward<Receiver>(r));
+    }
+};
+
+template<receiver Receiver>
+struct take_receiver
+{
+   Receiver r;
+   std::size_t remaining;
+   bool exhausted = false;
+
+   template<typename... Args>
+   auto set_next(Args&&... args)
+   {
+      using next_sender = next_sender_t<Receiver, Args...>;
+      using result_type = take_next_sender<next_sender, bool>;
+      if (remaining == 0)
+      {
+         exhausted = true;
+         return result_type{std::nullopt, &exhausted};
+      }
+
+      exhausted = (--remaining == 0);
+      return result_type{r.set_next(std::forward<Args>(args)...), &exhausted};
+   }
+
+   void set_value() &&
+   {
+      std::move(r).set_value();
+   }
+
+   template<typename Error>
+   void set_error(Error&& err) && noexcept
+   {
+      std::move(r).set_error(std::forward<Error>(err));
+   }
+
+   void set_done() && noexcept
+   {
+      if (exhausted)
+        std::move(r).set_value();
+      else
+        std::move(r).set_done();
+   }
+};
+
+template<typed_sender Sequence>
+struct take_sender
+{
+    Sequence seq;
+    std::size_t count;
+
+    template<template<class...> class Tuple, template<class...> class Variant>
+      using value_types = typename sender_traits<Sequence>::template value_types<Tuple, Variant>;
+    template<template<class...> class Variant>
+      using error_types = typename sender_traits<Sequence>::template error_types<Variant>;
+    static constexpr bool sends_done = sender_traits<Sequence>::sends_done;
+
+    template<typename Receiver>
+      requires sequence_receiver_for<Receiver, Sequence>
+    friend auto connect(take_sender s, Receiver&& r)
+    {
+       using decayed_receiver = std::remove_cvref_t<Receiver>;
+       using nested_receiver = take_receiver<decayed_receiver>;
+       using nested_operation = operation_state_type<Sequence, nested_receiver>;
+
+       // take(seq, 0) completes at start(), without starting the sequence
+       struct operation_type
+       {
+          std::optional<decayed_receiver> r;
+          std::optional<nested_operation> nested_op;
+
+          explicit operation_type(take_sender&& s, Receiver&& r)
+          {
+             if (s.count == 0)
+             {
+               this->r.emplace(std::forward<Receiver>(r));
+               return;
+             }
+
+             nested_op.emplace(init_from_invoke{[&] {
+               return connect(std::move(s.seq), nested_receiver{std::forward<Receiver>(r), s.count});
+             }});
+          }
+
+          operation_type(operation_type&&) = delete;
+
+          void start() &&
+          {
+             if (nested_op)
+               std::move(*nested_op).start();
+             else
+               std::move(*r).set_value();
+          }
+       };
+
+       return operation_type(std::move(s), std::forward<Receiver>(r));
+    }
+
+    auto scheduler() const
+      requires sender_with_scheduler<Sequence>
+    {
+      return seq.scheduler();
+    }
+};
+
+template<typed_sender Sequence>
+take_sender<std::remove_cvref_t<Sequence>> take(Sequence&& seq, std::size_t count)
+{
+  return {std::forward<Sequence>(seq), count};
+}
+
+template<typename Derived, typename Receiver, typename Item>
+struct tuple_sequence_emitter_impl;
+
+template<typename Derived, typename Receiver, typename... Values>
+struct tuple_sequence_emitter_impl<Derived, Receiver, std::tuple<Values...>>
+{
+   using type = sequence_emitter<Derived, Receiver, Values...>;
+};
+
+template<typename Derived, typename Receiver, typename Item>
+using tuple_sequence_emitter = typename tuple_sequence_emitter_impl<Derived, Receiver, Item>::type;
+
+template<typename... Values>
+using single_item_tuple = std::tuple<Values...>;
+
+template<typename Item>
+using single_item = Item;
+
+// Error of the upstream of the buffer, one of its error types.
+template<typename... Errors>
+using buffer_error_storage = unique_compact_result_t<received_error<std::remove_cvref_t<Errors>>...>;
+
+// Shared between the producer (upstream next-senders) and the consumer
+// (emitting to downstream) side of the buffer.
+template<typename Item, typename UpstreamError>
+struct buffer_state_base
+{
+   struct push_waiter
+   {
+      explicit push_waiter(Item&& i) : item(std::move(i))
+      {}
+
+      virtual void resume(bool stop) && = 0;
+      Item item;
+   };
+
+   std::mutex m;
+   std::deque<Item> items;
+   std::size_t capacity;
+   push_waiter* pending_push = nullptr;
+   bool consumer_idle = true;
+   bool consumer_stopped = false;
+   bool upstream_finished = false;
+   bool finished = false;
+   UpstreamError upstream_error;
+   bool upstream_done = false;
+
+   // at least one item is stored, so the consumer is woken by the producer
+   explicit buffer_state_base(std::size_t cap) : capacity(std::max<std::size_t>(cap, 1))
+   {}
+
+   virtual void resume_consumer() = 0;
+   virtual void complete() = 0;
+
+   // Returns true if the item was stored, false if producer must wait.
+   bool push(push_waiter* waiter, bool& stop)
+   {
+      std::unique_lock<std::mutex> lock(m);
+      if (consumer_stopped)
+      {
+         stop = true;
+         return true;
+      }
+
+      if (items.size() >= capacity)
+      {
+         pending_push = waiter;
+         return false;
+      }
+
+      items.push_back(std::move(waiter->item));
+      bool wake = std::exchange(consumer_idle, false);
+      lock.unlock();
+
+      if (wake)
+        resume_consumer();
+      return true;
+   }
+
+   void upstream_completed()
+   {
+      std::unique_lock<std::mutex> lock(m);
+      upstream_finished = true;
+      if (!consumer_idle || finished)
+        return;
+      finished = true;
+      lock.unlock();
+      complete();
+   }
+};
+
+template<typename Item, typename UpstreamError>
+struct buffer_push_sender
+{
+    buffer_state_base<Item, UpstreamError>* state;
+    Item item;
+
+    template<typename Receiver>
+    friend auto connect(buffer_push_sender s, Receiver&& r)
+    {
+       using base_waiter = typename buffer_state_base<Item, UpstreamError>::push_waiter;
+
+       struct operation_type : base_waiter
+       {
+          buffer_state_base<Item, UpstreamError>* state;
+          std::remove_cvref_t<Receiver> r;
+
+          explicit operation_type(buffer_push_sender&& s, Receiver&& r)
+            : base_waiter(std::move(s.item)), state(s.state), r(std::forward<Receiver>(r))
+          {}
+
+          operation_type(operation_type&&) = delete;
+
+          void start() &&
+          {
+             bool stop = false;
+             if (state->push(this, stop))
+               std::move(*this).resume(stop);
+          }
+
+          void resume(bool stop) && override
+          {
+             if (stop)
+               std::move(r).set_done();
+             else
+               std::move(r).set_value();
+          }
+       };
+
+       return operation_type(std::move(s), std::forward<Receiver>(r));
+    }
+};
+
+template<typename Item, typename UpstreamError>
+struct buffer_receiver
+{
+   buffer_state_base<Item, UpstreamError>* state;
+
+   template<typename... Args>
+   buffer_push_sender<Item, UpstreamError> set_next(Args&&... args)
+   {
+      return {state, Item(std::forward<Args>(args)...)};
+   }
+
+   void set_value() &&
+   {
+      state->upstream_completed();
+   }
+
+   template<typename Error>
+   void set_error(Error&& err) && noexcept
+   {
+      using type = received_error<std::remove_cvref_t<Error>>;
+      state->upstream_error.template emplace<type>(std::forward<Error>(err));
+      state->upstream_completed();
+   }
+
+   void set_done() && noexcept
+   {
+      state->upstream_done = true;
+      state->upstream_completed();
+   }
+};
+
+// Stores up to count items produced by the upstream, so the producer
+// may run ahead of the consumer; the producer is suspended when the buffer is full.
+// A count of 0 is treated as 1.
+template<typed_sender Sequence>
+struct buffer_sender
+{
+    Sequence seq;
+    std::size_t count;
+
+    using item_type = typename sender_traits<Sequence>::template value_types<single_item_tuple, single_item>;
+    using upstream_error = typename sender_traits<Sequence>::template error_types<buffer_error_storage>;
+
+    // errors of the upstream, and of the downstream next-senders
+    template<template<class...> class Tuple, template<class...> class Variant>
+      using value_types = typename sender_traits<Sequence>::template value_types<Tuple, Variant>;
+    template<template<class...> class Variant>
+      using error_types = typename concat_type_lists<
+        Variant,
+        typename sender_traits<Sequence>::template error_types<type_list>,
+        type_list<std::exception_ptr>>::type;
+    static constexpr bool sends_done = true;
+
+    template<typename Receiver>
+      requires sequence_receiver_for<Receiver, Sequence>
+    friend auto connect(buffer_sender s, Receiver&& r)
+    {
+       using decayed_receiver = std::remove_cvref_t<Receiver>;
+
+       struct operation_type;
+       using emitter_type = tuple_sequence_emitter<operation_type, decayed_receiver, item_type>;
+
+       using state_type = buffer_state_base<item_type, upstream_error>;
+       using upstream_receiver = buffer_receiver<item_type, upstream_error>;
+
+       struct operation_type : state_type, emitter_type
+       {
+          decayed_receiver r;
+          using upstream_operation = operation_state_type<Sequence, upstream_receiver>;
+          upstream_operation upstream_op;
+
+          explicit operation_type(buffer_sender&& s, Receiver&& r)
+            : state_type(s.count),
+              r(std::forward<Receiver>(r)),
+              upstream_op(connect(std::move(s.seq), upstream_receiver{this}))
+          {}
+
+          operation_type(operation_type&&) = delete;
+
+          void start() &&
+          {
+             std::move(upstream_op).start();
+          }
+
+          void resume()
+          {
+             if (this->stopped)
+               return stop_consumer();
+             resume_consumer();
+          }
+
+          void resume_consumer() override
+          {
+             while (true)
+             {
+                std::unique_lock<std::mutex> lock(this->m);
+                if (this->items.empty())
+                {
+                   this->consumer_idle = true;
+                   if (!this->upstream_finished || std::exchange(this->finished, true))
+                     return;
+                   lock.unlock();
+                   return complete();
+                }
+
+                item_type item = std::move(this->items.front());
+                this->items.pop_front();
+                auto* waiter = std::exchange(this->pending_push, nullptr);
+                if (waiter)
+                  this->items.push_back(std::move(waiter->item));
+                lock.unlock();
+
+                if (waiter)
+                  std::move(*waiter).resume(false);
+
+                bool consumed = std::apply([this](auto&... vals) {
+                  return this->emit(r, std::move(vals)...);
+                }, item);
+
+                if (!consumed)
+                  return;
+                if (this->stopped)
+                  return stop_consumer();
+             }
+          }
+
+          void stop_consumer()
+          {
+             std::unique_lock<std::mutex> lock(this->m);
+             this->consumer_stopped = true;
+             this->consumer_idle = true;
+             this->items.clear();
+             auto* waiter = std::exchange(this->pending_push, nullptr);
+             bool done = this->upstream_finished && !std::exchange(this->finished, true);
+             lock.unlock();
+
+             if (waiter)
+               std::move(*waiter).resume(true);
+             if (done)
+               complete();
+          }
+
+          void complete() override
+          {
+             if (!this->error && !this->stopped)
+             {
+               if (this->upstream_error.has_value())
+               {
+                 this->next_op.reset();
+                 return this->upstream_error.visit([this](auto& err) {
+                   std::move(r).set_error(std::move(err.value));
+                 });
+               }
+               this->stopped = this->upstream_done;
+             }
+             this->finish(std::move(r));
+          }
+       };
+
+       return operation_type(std::move(s), std::forward<Receiver>(r));
+    }
+
+    auto scheduler() const
+      requires sender_with_scheduler<Sequence>
+    {
+      return seq.scheduler();
+    }
+};
+
+template<typed_sender Sequence>
+buffer_sender<std::remove_cvref_t<Sequence>> buffer(Sequence&& seq, std::size_t count)
+{
+  return {std::forward<Sequence>(seq), count};
+}
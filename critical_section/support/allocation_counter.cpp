@@ -0,0 +1,51 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "allocation_counter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<std::size_t> allocations{0};
+std::atomic<std::size_t> bytes_allocated{0};
+
+} // namespace
+
+std::size_t allocation_count()
+{
+   return allocations.load(std::memory_order_relaxed);
+}
+
+std::size_t allocated_bytes()
+{
+   return bytes_allocated.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t bytes)
+{
+   allocations.fetch_add(1, std::memory_order_relaxed);
+   bytes_allocated.fetch_add(bytes, std::memory_order_relaxed);
+   if (void* p = std::malloc(bytes ? bytes : 1))
+     return p;
+   throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+   std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+   std::free(p);
+}
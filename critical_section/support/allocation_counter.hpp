@@ -0,0 +1,20 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#pragma once
+
+#include <cstddef>
+
+// Number of calls of the replaceable global operator new so far, made by
+// any thread of the process.
+std::size_t allocation_count();
+
+// Number of bytes requested from the replaceable global operator new so far.
+std::size_t allocated_bytes();
@@ -0,0 +1,50 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "cache_miss_counter.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+cache_miss_counter::cache_miss_counter()
+{
+#ifdef __linux__
+   perf_event_attr attr{};
+   attr.type = PERF_TYPE_HARDWARE;
+   attr.size = sizeof(attr);
+   attr.config = PERF_COUNT_HW_CACHE_MISSES;
+   attr.inherit = 1;
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+}
+
+cache_miss_counter::~cache_miss_counter()
+{
+#ifdef __linux__
+   if (fd >= 0)
+     close(fd);
+#endif
+}
+
+std::uint64_t cache_miss_counter::count() const
+{
+   std::uint64_t value = 0;
+#ifdef __linux__
+   // misses of the started threads are included once they have exited
+   if (fd >= 0 && read(fd, &value, sizeof(value)) != sizeof(value))
+     value = 0;
+#endif
+   return value;
+}
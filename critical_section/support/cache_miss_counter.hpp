@@ -0,0 +1,37 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// Hardware cache misses (perf events) of the thread that created the counter
+// and of the threads it starts afterwards. Not available outside of Linux, or
+// when perf events are not permitted (e.g. in containers and virtual machines).
+class cache_miss_counter
+{
+public:
+   cache_miss_counter();
+   cache_miss_counter(cache_miss_counter const&) = delete;
+   cache_miss_counter& operator=(cache_miss_counter const&) = delete;
+   ~cache_miss_counter();
+
+   bool available() const
+   {
+      return fd >= 0;
+   }
+
+   // Misses counted since construction, 0 if not available. Misses of the
+   // started threads are included only after they have exited.
+   std::uint64_t count() const;
+
+private:
+   int fd = -1;
+};
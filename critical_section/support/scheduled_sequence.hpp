@@ -0,0 +1,43 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#pragma once
+#include "concepts.hpp"
+
+#include <type_traits>
+#include <utility>
+
+// Sequence sender reporting the given scheduler instead of its own, e.g. of
+// a thread_pool, so locked() applied to its items (see for_each) resumes on
+// that scheduler after waiting for the lock.
+template<typed_sender Sequence, scheduler Scheduler>
+struct scheduled_sequence : forwarded_sender_types<Sequence>
+{
+   Sequence seq;
+   Scheduler sched;
+
+   template<typename Receiver>
+   friend auto connect(scheduled_sequence s, Receiver&& r)
+     -> decltype(connect(std::move(s.seq), std::forward<Receiver>(r)))
+   {
+      return connect(std::move(s.seq), std::forward<Receiver>(r));
+   }
+
+   Scheduler scheduler() const
+   {
+      return sched;
+   }
+};
+
+template<typed_sender Sequence, scheduler Scheduler>
+scheduled_sequence<std::remove_cvref_t<Sequence>, Scheduler> schedule_items_on(Sequence&& seq, Scheduler sched)
+{
+   return {{}, std::forward<Sequence>(seq), std::move(sched)};
+}
@@ -0,0 +1,85 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#pragma once
+#include "concepts.hpp"
+
+#include <latch>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// Operation state of the sender connected to the receiver, that is started
+// on construction and stays in place until destroyed.
+template<sender Sender, receiver Receiver>
+class started_operation
+{
+public:
+   started_operation(Sender s, Receiver r)
+   {
+      op.emplace(init_from_invoke{[&] { return connect(std::move(s), std::move(r)); }});
+      std::move(*op).start();
+   }
+
+   started_operation(started_operation&&) = delete;
+
+private:
+   std::optional<operation_state_type<Sender, Receiver>> op;
+};
+
+// Starts the operation on the heap; the result must outlive its completion.
+template<sender Sender, receiver Receiver>
+std::shared_ptr<void> start_operation(Sender&& s, Receiver&& r)
+{
+   using operation = started_operation<std::remove_cvref_t<Sender>, std::remove_cvref_t<Receiver>>;
+   return std::make_shared<operation>(std::forward<Sender>(s), std::forward<Receiver>(r));
+}
+
+// Forwards the completion to the receiver, and then counts down the latch.
+template<receiver Receiver>
+struct counting_down_receiver
+{
+   Receiver r;
+   std::latch* latch;
+
+   template<typename... Args>
+     requires receiver_of<Receiver, Args...>
+   void set_value(Args&&... args) && noexcept
+   {
+      set_value_or_error(std::move(r), std::forward<Args>(args)...);
+      latch->count_down();
+   }
+
+   template<typename Error>
+   void set_error(Error&& err) && noexcept
+   {
+      std::move(r).set_error(std::forward<Error>(err));
+      latch->count_down();
+   }
+
+   void set_done() && noexcept
+   {
+      std::move(r).set_done();
+      latch->count_down();
+   }
+};
+
+// Runs the operation, blocking the calling thread until it completes.
+template<sender Sender, receiver Receiver>
+void sync_wait(Sender&& s, Receiver&& r)
+{
+   using forwarding_receiver = counting_down_receiver<std::remove_cvref_t<Receiver>>;
+
+   std::latch latch(1);
+   started_operation<std::remove_cvref_t<Sender>, forwarding_receiver> op(
+     std::forward<Sender>(s), forwarding_receiver{std::forward<Receiver>(r), &latch});
+   latch.wait();
+}
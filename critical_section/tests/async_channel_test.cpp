@@ -0,0 +1,153 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "async_channel.hpp"
+#include "test_receivers.hpp"
+#include "test_registry.hpp"
+
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace {
+
+TEST_CASE(mpmc_ring_buffer, holds_single_value_with_capacity_one)
+{
+   mpmc_ring_buffer<int> ring(1);
+   int first = 1, second = 2;
+   REQUIRE(ring.try_push(first));
+   CHECK(!ring.try_push(second));
+
+   std::optional<int> out;
+   REQUIRE(ring.try_pop(out));
+   CHECK(out == 1);
+   CHECK(!ring.try_pop(out));
+
+   REQUIRE(ring.try_push(second));
+   REQUIRE(ring.try_pop(out));
+   CHECK(out == 2);
+}
+
+TEST_CASE(mpmc_ring_buffer, holds_capacity_values)
+{
+   mpmc_ring_buffer<int> ring(3);
+   for (int round = 0; round < 4; ++round)
+   {
+      for (int i = 0; i < 3; ++i)
+        REQUIRE(ring.try_push(i));
+      int extra = 3;
+      CHECK(!ring.try_push(extra));
+
+      std::optional<int> out;
+      for (int i = 0; i < 3; ++i)
+      {
+         REQUIRE(ring.try_pop(out));
+         CHECK(out == i);
+      }
+      CHECK(!ring.try_pop(out));
+   }
+}
+
+TEST_CASE(async_channel, send_waits_for_free_slot_with_capacity_one)
+{
+   async_channel<int> ch(1);
+   completion<> sent1, sent2;
+   started_operation send1(ch.send(1), completion_receiver<>{&sent1});
+   started_operation send2(ch.send(2), completion_receiver<>{&sent2});
+   CHECK(sent1.count == 1);
+   CHECK(sent2.count == 0);
+
+   completion<int> received1;
+   started_operation receive1(ch.receive(), completion_receiver<int>{&received1});
+   CHECK(received1.values == std::tuple(1));
+   CHECK(sent2.count == 1);
+
+   completion<int> received2;
+   started_operation receive2(ch.receive(), completion_receiver<int>{&received2});
+   CHECK(received2.values == std::tuple(2));
+}
+
+TEST_CASE(async_channel, close_completes_waiting_operations_with_done)
+{
+   async_channel<int> ch(1);
+   completion<> sent1, sent2;
+   started_operation send1(ch.send(1), completion_receiver<>{&sent1});
+   started_operation send2(ch.send(2), completion_receiver<>{&sent2});
+   ch.close();
+   CHECK(sent2.done);
+
+   completion<int> received1, received2;
+   started_operation receive1(ch.receive(), completion_receiver<int>{&received1});
+   started_operation receive2(ch.receive(), completion_receiver<int>{&received2});
+   CHECK(received1.values == std::tuple(1));
+   CHECK(received2.done);
+}
+
+struct sum_receiver
+{
+   long* sum;
+   bool* closed;
+
+   void set_value(int v) && noexcept
+   {
+      *sum += v;
+   }
+
+   void set_value() && noexcept
+   {}
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {
+      report_failure("unexpected set_error");
+   }
+
+   void set_done() && noexcept
+   {
+      *closed = true;
+   }
+};
+
+TEST_CASE(async_channel, transfers_all_values_between_threads)
+{
+   constexpr int threads = 4;
+   constexpr int per_thread = 2000;
+   async_channel<int> ch(3);
+
+   std::atomic<long> total{0};
+   {
+      std::vector<std::jthread> receivers;
+      for (int t = 0; t < threads; ++t)
+        receivers.emplace_back([&] {
+           long sum = 0;
+           bool closed = false;
+           while (!closed)
+             sync_wait(ch.receive(), sum_receiver{&sum, &closed});
+           total += sum;
+        });
+
+      {
+         std::vector<std::jthread> senders;
+         for (int t = 0; t < threads; ++t)
+           senders.emplace_back([&] {
+              long unused = 0;
+              bool closed = false;
+              for (int i = 1; i <= per_thread; ++i)
+                sync_wait(ch.send(i), sum_receiver{&unused, &closed});
+              CHECK(!closed);
+           });
+      }
+      ch.close();
+   }
+   CHECK(total == long(threads) * per_thread * (per_thread + 1) / 2);
+}
+
+} // namespace
@@ -0,0 +1,94 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "async_mutex.hpp"
+#include "locked_sender.hpp"
+#include "helpers.hpp"
+#include "thread_pool.hpp"
+#include "test_receivers.hpp"
+#include "test_registry.hpp"
+
+#include <chrono>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+TEST_CASE(async_mutex, try_lock_fails_while_held)
+{
+   async_mutex m;
+   REQUIRE(m.try_lock());
+   CHECK(!m.try_lock());
+   m.unlock();
+   REQUIRE(m.try_lock());
+   m.unlock();
+}
+
+TEST_CASE(async_mutex, lock_waits_for_unlock)
+{
+   async_mutex m;
+   REQUIRE(m.try_lock());
+
+   std::atomic<bool> acquired{false};
+   std::jthread waiter([&] {
+      std::lock_guard<async_mutex> lock(m);
+      acquired = true;
+   });
+   std::this_thread::sleep_for(10ms);
+   CHECK(!acquired);
+
+   m.unlock();
+   waiter.join();
+   CHECK(acquired);
+   REQUIRE(m.try_lock());
+   m.unlock();
+}
+
+// Blocking lock() users and locked() operations on the pool, that are
+// granted the mutex from the same queue.
+TEST_CASE(async_mutex, blocking_and_async_users_are_serialized)
+{
+   constexpr int threads = 4;
+   constexpr int iterations = 2000;
+   constexpr int operations = 4000;
+
+   async_mutex m;
+   // not atomic: ThreadSanitizer reports the race if the accesses are not serialized
+   long counter = 0;
+   auto work = [&](auto s) { return then(std::move(s), [&] { return ++counter; }); };
+
+   std::latch latch(operations);
+   std::vector<std::shared_ptr<void>> ops;
+   ops.reserve(operations);
+   {
+      thread_pool pool(2);
+      std::vector<std::jthread> users;
+      for (int t = 0; t < threads; ++t)
+        users.emplace_back([&] {
+           for (int i = 0; i < iterations; ++i)
+           {
+              std::lock_guard<async_mutex> lock(m);
+              ++counter;
+           }
+        });
+
+      for (int i = 0; i < operations; ++i)
+        ops.push_back(start_operation(locked(pool.scheduler().schedule(), work, m), latch_receiver{&latch}));
+      latch.wait();
+   }
+   CHECK(counter == long(threads) * iterations + operations);
+}
+
+} // namespace
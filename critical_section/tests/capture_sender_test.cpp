@@ -0,0 +1,197 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "capture_sender.hpp"
+#include "resume_via_sender.hpp"
+#include "helpers.hpp"
+#include "thread_pool.hpp"
+#include "test_receivers.hpp"
+#include "test_registry.hpp"
+
+#include <latch>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+using just10_result = received_result_t<just10_sender>;
+
+// Receiver of the stored result, holding a single pointer.
+template<typename StoredResult>
+struct pointer_receiver
+{
+   StoredResult** out;
+
+   void set_value(StoredResult& res) &&
+   {
+      *out = &res;
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {}
+
+   void set_done() && noexcept
+   {}
+};
+
+template<typename Sender>
+using capture_operation_t =
+  operation_state_type<capture_sender<Sender>, pointer_receiver<received_result_t<Sender>>>;
+
+// Senders completing with a value or std::exception_ptr store the result in
+// two words, and the capture_args() operation adds only the nested operation.
+static_assert(sizeof(received_result_t<just10_sender>) == 2 * sizeof(void*));
+static_assert(sizeof(received_result_t<inline_sender>) == 2 * sizeof(void*));
+static_assert(sizeof(received_result_t<thread_pool::sender_type>) == 2 * sizeof(void*));
+static_assert(sizeof(capture_operation_t<just10_sender>) == 4 * sizeof(void*));
+static_assert(sizeof(capture_operation_t<inline_sender>) == 4 * sizeof(void*));
+// the handoff flag of the thread_pool operation is padded to a word
+static_assert(sizeof(capture_operation_t<thread_pool::sender_type>) == 5 * sizeof(void*));
+
+// Visits the captured result, and records which alternative was stored.
+struct capture_visitor
+{
+   int* value;
+   bool* failed;
+
+   void operator()(received_values<int>& v) { *value = std::get<0>(v.value); }
+   void operator()(received_error<std::exception_ptr>&) { *failed = true; }
+};
+
+struct stored_result_receiver
+{
+   int* value;
+   bool* failed;
+
+   void set_value(just10_result& res) &&
+   {
+      res.visit(capture_visitor{value, failed});
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {
+      report_failure("capture_args() delivers errors as values");
+   }
+
+   void set_done() && noexcept
+   {
+      report_failure("capture_args() delivers done as a value");
+   }
+};
+
+TEST_CASE(capture_args, delivers_values_as_stored_result)
+{
+   int value = 0;
+   bool failed = false;
+   started_operation op(capture_args(just10_sender{}), stored_result_receiver{&value, &failed});
+   CHECK(value == 10);
+   CHECK(!failed);
+}
+
+TEST_CASE(capture_args, delivers_errors_as_stored_result)
+{
+   auto fail = [](int) -> int { throw std::runtime_error("failed"); };
+   using failing_result = received_result_t<decltype(then(just10_sender{}, fail))>;
+   static_assert(std::is_same_v<failing_result, just10_result>);
+
+   int value = 0;
+   bool failed = false;
+   started_operation op(capture_args(then(just10_sender{}, fail)), stored_result_receiver{&value, &failed});
+   CHECK(value == 0);
+   CHECK(failed);
+}
+
+TEST_CASE(resume_via, inline_scheduler_delivers_stored_values)
+{
+   just10_result store;
+   store.emplace<received_values<int>>(10);
+
+   completion<int> result;
+   started_operation op(resume_via(inline_scheduler{}, store), completion_receiver<int>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(result.values == std::tuple(10));
+}
+
+TEST_CASE(resume_via, inline_scheduler_delivers_stored_error)
+{
+   just10_result store;
+   store.emplace<received_error<std::exception_ptr>>(std::make_exception_ptr(std::runtime_error("failed")));
+
+   completion<int> result;
+   started_operation op(resume_via(inline_scheduler{}, store), completion_receiver<int>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(!result.values);
+   CHECK(result.error);
+}
+
+// Completes inline like inline_scheduler, but is not recognized as one, so
+// resume_via() starts the schedule sender.
+struct opaque_inline_scheduler
+{
+   inline_sender schedule()
+   {
+      return {};
+   }
+};
+
+TEST_CASE(resume_via, scheduler_completing_in_start_delivers_stored_values)
+{
+   just10_result store;
+   store.emplace<received_values<int>>(10);
+
+   completion<int> result;
+   started_operation op(resume_via(opaque_inline_scheduler{}, store), completion_receiver<int>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(result.values == std::tuple(10));
+}
+
+struct thread_receiver
+{
+   std::thread::id* id;
+   std::latch* latch;
+
+   void set_value(int) &&
+   {
+      *id = std::this_thread::get_id();
+      latch->count_down();
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {
+      report_failure("unexpected set_error");
+      latch->count_down();
+   }
+
+   void set_done() && noexcept
+   {
+      report_failure("unexpected set_done");
+      latch->count_down();
+   }
+};
+
+TEST_CASE(resume_via, thread_pool_delivers_stored_values_on_worker)
+{
+   just10_result store;
+   store.emplace<received_values<int>>(10);
+
+   std::thread::id id;
+   std::latch latch(1);
+   // destroyed after the pool is joined
+   std::shared_ptr<void> op;
+   thread_pool pool(2);
+   op = start_operation(resume_via(pool.scheduler(), store), thread_receiver{&id, &latch});
+   latch.wait();
+   CHECK(id != std::this_thread::get_id());
+}
+
+} // namespace
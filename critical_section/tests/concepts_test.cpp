@@ -0,0 +1,102 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "concepts.hpp"
+#include "capture_sender.hpp"
+#include "helpers.hpp"
+#include "locked_sender.hpp"
+#include "seqlock.hpp"
+#include "thread_pool.hpp"
+
+#include <exception>
+
+// Compile-time checks only: a sender must not be connectable to a receiver,
+// that does not accept its values, without instantiating the connect().
+
+namespace {
+
+struct int_receiver
+{
+   void set_value(int) &&;
+   void set_error(std::exception_ptr) && noexcept;
+   void set_done() && noexcept;
+};
+
+struct void_receiver
+{
+   void set_value() &&;
+   void set_error(std::exception_ptr) && noexcept;
+   void set_done() && noexcept;
+};
+
+struct nothrow_int_receiver
+{
+   void set_value(int) && noexcept;
+   void set_error(std::exception_ptr) && noexcept;
+   void set_done() && noexcept;
+};
+
+auto increment = [](int v) { return v + 1; };
+auto identity_work = [](auto s) { return s; };
+auto increment_work = [](auto s) { return then(std::move(s), increment); };
+
+template<typename Work>
+using locked_t = decltype(locked(just10_sender{}, std::declval<Work>(), std::declval<async_mutex&>()));
+
+template<typename Work>
+using multi_locked_t = decltype(locked(just10_sender{}, std::declval<Work>(),
+                                       std::declval<async_mutex&>(), std::declval<async_mutex&>()));
+
+template<typename Work>
+using seqlock_locked_t = decltype(locked(just10_sender{}, std::declval<Work>(), std::declval<seqlock&>()));
+
+// set_value_or_error() omits the exception handler only for these
+static_assert(nothrow_receiver_of<nothrow_int_receiver, int>);
+static_assert(!nothrow_receiver_of<int_receiver, int>);
+static_assert(!nothrow_receiver_of<nothrow_int_receiver>);
+
+static_assert(receiver_for<int_receiver, just10_sender>);
+static_assert(!receiver_for<void_receiver, just10_sender>);
+
+static_assert(sender_to<just10_sender, int_receiver>);
+static_assert(!sender_to<just10_sender, void_receiver>);
+
+static_assert(!sender_to<decltype(capture_args(just10_sender{})), int_receiver>);
+
+// the locking sender forwards the values of the sender, so the work can be checked
+static_assert(typed_sender<locking_sender_t<just10_sender>>);
+static_assert(typed_sender<decltype(then(std::declval<locking_sender_t<just10_sender>>(), increment))>);
+
+static_assert(sender_to<decltype(then(just10_sender{}, increment)), int_receiver>);
+static_assert(!sender_to<decltype(then(just10_sender{}, increment)), void_receiver>);
+
+static_assert(sender_to<locked_t<decltype(identity_work)>, int_receiver>);
+static_assert(!sender_to<locked_t<decltype(identity_work)>, void_receiver>);
+static_assert(sender_to<locked_t<decltype(increment_work)>, int_receiver>);
+static_assert(!sender_to<locked_t<decltype(increment_work)>, void_receiver>);
+
+static_assert(sender_to<multi_locked_t<decltype(identity_work)>, int_receiver>);
+static_assert(!sender_to<multi_locked_t<decltype(identity_work)>, void_receiver>);
+static_assert(sender_to<multi_locked_t<decltype(increment_work)>, int_receiver>);
+static_assert(!sender_to<multi_locked_t<decltype(increment_work)>, void_receiver>);
+
+static_assert(sender_to<seqlock_locked_t<decltype(identity_work)>, int_receiver>);
+static_assert(!sender_to<seqlock_locked_t<decltype(identity_work)>, void_receiver>);
+static_assert(sender_to<seqlock_locked_t<decltype(increment_work)>, int_receiver>);
+static_assert(!sender_to<seqlock_locked_t<decltype(increment_work)>, void_receiver>);
+
+static_assert(sender_to<decltype(locked(thread_pool::sender_type(std::declval<thread_pool&>()), identity_work,
+                                        std::declval<async_mutex&>())),
+                        void_receiver>);
+static_assert(!sender_to<decltype(locked(thread_pool::sender_type(std::declval<thread_pool&>()), identity_work,
+                                         std::declval<async_mutex&>())),
+                         int_receiver>);
+
+} // namespace
@@ -0,0 +1,118 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+// Built into critical_section_instrumented_tests, with CRITICAL_SECTION_PROFILE_CONTENTION defined.
+#include "contention_profiler.hpp"
+#include "locked_sender.hpp"
+#include "helpers.hpp"
+#include "test_receivers.hpp"
+#include "test_registry.hpp"
+
+#include <optional>
+#include <source_location>
+
+namespace {
+
+std::optional<contention_report_entry> entry_of(std::source_location const& loc)
+{
+   for (auto const& entry : contention_profiler::report())
+     if (entry.line == loc.line() && entry.column == loc.column())
+       return entry;
+   return std::nullopt;
+}
+
+auto identity_work = [](auto s) { return s; };
+
+TEST_CASE(contention_profiler, counts_uncontended_acquisitions)
+{
+   async_mutex m;
+   auto site = std::source_location::current();
+   for (int i = 0; i < 3; ++i)
+   {
+      completion<int> result;
+      started_operation op(locked(just10_sender{}, identity_work, m, site), completion_receiver<int>{&result});
+      REQUIRE(result.count == 1);
+   }
+
+   auto entry = entry_of(site);
+   REQUIRE(entry.has_value());
+   CHECK(entry->acquisitions == 3);
+   CHECK(entry->contended == 0);
+   CHECK(entry->total_wait_ns == 0);
+}
+
+TEST_CASE(contention_profiler, counts_handed_over_acquisitions)
+{
+   contention_profiler::set_sampling_period(1);
+   async_mutex m;
+   auto site = std::source_location::current();
+   REQUIRE(m.try_lock());
+
+   completion<int> result;
+   started_operation op(locked(just10_sender{}, identity_work, m, site), completion_receiver<int>{&result});
+   CHECK(result.count == 0);
+   m.unlock();
+   REQUIRE(result.count == 1);
+
+   auto entry = entry_of(site);
+   REQUIRE(entry.has_value());
+   CHECK(entry->acquisitions == 1);
+   CHECK(entry->contended == 1);
+   CHECK(entry->total_wait_ns > 0);
+   contention_profiler::set_sampling_period(contention_profiler::default_sampling_period);
+}
+
+TEST_CASE(contention_profiler, estimates_wait_from_sampled_acquisitions)
+{
+   constexpr int count = 8;
+   contention_profiler::set_sampling_period(4);
+   async_mutex m;
+   auto site = std::source_location::current();
+   for (int i = 0; i < count; ++i)
+   {
+      REQUIRE(m.try_lock());
+      completion<int> result;
+      started_operation op(locked(just10_sender{}, identity_work, m, site), completion_receiver<int>{&result});
+      m.unlock();
+      REQUIRE(result.count == 1);
+   }
+
+   // two of the acquisitions were timed
+   auto entry = entry_of(site);
+   REQUIRE(entry.has_value());
+   CHECK(entry->acquisitions == count);
+   CHECK(entry->contended == count);
+   CHECK(entry->total_wait_ns > 0);
+   contention_profiler::set_sampling_period(contention_profiler::default_sampling_period);
+}
+
+TEST_CASE(contention_profiler, resolves_call_site_once_per_thread)
+{
+   auto site = std::source_location::current();
+   contention_profiler::site* stats = contention_profiler::resolve(site);
+   REQUIRE(stats != nullptr);
+   CHECK(contention_profiler::resolve(site) == stats);
+   CHECK(contention_profiler::find(site) == stats);
+}
+
+TEST_CASE(contention_profiler, reset_clears_counters)
+{
+   async_mutex m;
+   auto site = std::source_location::current();
+   completion<int> result;
+   started_operation op(locked(just10_sender{}, identity_work, m, site), completion_receiver<int>{&result});
+
+   contention_profiler::reset();
+   auto entry = entry_of(site);
+   REQUIRE(entry.has_value());
+   CHECK(entry->acquisitions == 0);
+}
+
+} // namespace
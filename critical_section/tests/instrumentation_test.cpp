@@ -0,0 +1,121 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+// Built into critical_section_instrumented_tests, with CRITICAL_SECTION_TRACING defined.
+#include "instrumentation.hpp"
+#include "async_mutex.hpp"
+#include "test_registry.hpp"
+
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+std::size_t count_of(std::string const& text, std::string const& needle)
+{
+   std::size_t count = 0;
+   for (std::size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + 1))
+     ++count;
+   return count;
+}
+
+std::string chrome_trace()
+{
+   std::ostringstream out;
+   trace_recorder::write_chrome_trace(out);
+   return out.str();
+}
+
+void record(char const* name)
+{
+   trace_stamp start = trace_stamp::now();
+   trace_recorder::record(name, "test", nullptr, start, trace_stamp::now());
+}
+
+TEST_CASE(histogram_snapshot, percentile_is_within_bucket)
+{
+   histogram_snapshot h;
+   for (std::uint64_t v = 1; v <= 1000; ++v)
+     ++h.counts[histogram_snapshot::bucket_of(v)];
+   CHECK(h.total() == 1000);
+
+   std::uint64_t median = h.percentile(50);
+   CHECK(median <= 500);
+   CHECK(median * 9 / 8 >= 500);
+}
+
+TEST_CASE(trace_recorder, writes_recorded_events)
+{
+   record("writes_recorded_events");
+   std::string trace = chrome_trace();
+   CHECK(trace.starts_with("{\"traceEvents\":["));
+   CHECK(trace.ends_with("]}"));
+   CHECK(count_of(trace, "\"name\":\"writes_recorded_events\"") == 1);
+}
+
+TEST_CASE(trace_recorder, keeps_last_events_of_thread)
+{
+   std::thread([] {
+      record("dropped_event");
+      for (std::size_t i = 0; i < trace_recorder::events_per_thread; ++i)
+        record("kept_event");
+   }).join();
+
+   std::string trace = chrome_trace();
+   CHECK(count_of(trace, "\"name\":\"dropped_event\"") == 0);
+   CHECK(count_of(trace, "\"name\":\"kept_event\"") == trace_recorder::events_per_thread);
+}
+
+TEST_CASE(trace_recorder, reuses_buffers_of_exited_threads)
+{
+   std::thread([] { record("first_thread"); }).join();
+   std::size_t buffers = trace_recorder::buffer_count();
+   for (int i = 0; i < 10; ++i)
+     std::thread([] { record("later_thread"); }).join();
+   CHECK(trace_recorder::buffer_count() == buffers);
+
+   // events of the exited threads are kept
+   std::string trace = chrome_trace();
+   CHECK(count_of(trace, "\"name\":\"first_thread\"") == 1);
+   CHECK(count_of(trace, "\"name\":\"later_thread\"") == 10);
+}
+
+// The histograms are recorded outside of the mutex, that stays small.
+static_assert(sizeof(async_mutex) < 256);
+
+TEST_CASE(mutex_instrumentation, records_wait_and_hold_times)
+{
+   async_mutex m;
+   m.lock();
+   std::thread([&] {
+      m.unlock();
+      REQUIRE(m.try_lock());
+      m.unlock();
+   }).join();
+
+   CHECK(m.instrumentation().wait_time().total() == 2);
+   CHECK(m.instrumentation().hold_time().total() == 2);
+}
+
+TEST_CASE(histogram_registry, forgets_destroyed_objects)
+{
+   int object = 0;
+   histogram_registry::record(&object, 0, 10);
+   std::thread([&] { histogram_registry::record(&object, 0, 20); }).join();
+   CHECK(histogram_registry::snapshot(&object, 0).total() == 2);
+   CHECK(histogram_registry::snapshot(&object, 1).total() == 0);
+
+   histogram_registry::forget(&object);
+   CHECK(histogram_registry::snapshot(&object, 0).total() == 0);
+}
+
+} // namespace
@@ -0,0 +1,184 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "locked_sender.hpp"
+#include "helpers.hpp"
+#include "thread_pool.hpp"
+#include "test_receivers.hpp"
+#include "test_registry.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <latch>
+#include <memory>
+#include <semaphore>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+TEST_CASE(locked, delivers_result_of_work)
+{
+   async_mutex m;
+   auto work = [](auto s) { return then(std::move(s), [](int v) { return v + 1; }); };
+
+   completion<int> result;
+   started_operation op(locked(just10_sender{}, work, m), completion_receiver<int>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(result.values == std::tuple(11));
+
+   REQUIRE(m.try_lock());
+   m.unlock();
+}
+
+TEST_CASE(locked, releases_mutex_on_error)
+{
+   async_mutex m;
+   auto work = [](auto s) { return then(std::move(s), [](int) -> int { throw std::runtime_error("failed"); }); };
+
+   completion<int> result;
+   started_operation op(locked(just10_sender{}, work, m), completion_receiver<int>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(result.error);
+
+   REQUIRE(m.try_lock());
+   m.unlock();
+}
+
+TEST_CASE(locked, waits_until_mutex_is_released)
+{
+   async_mutex m;
+   bool entered = false;
+   auto work = [&](auto s) { return then(std::move(s), [&](int v) { entered = true; return v; }); };
+
+   REQUIRE(m.try_lock());
+   completion<int> result;
+   started_operation op(locked(just10_sender{}, work, m), completion_receiver<int>{&result});
+   CHECK(!entered);
+   CHECK(result.count == 0);
+
+   m.unlock();
+   CHECK(entered);
+   REQUIRE(result.count == 1);
+   CHECK(result.values == std::tuple(10));
+}
+
+TEST_CASE(locked, serializes_work_on_thread_pool)
+{
+   constexpr int count = 5000;
+   async_mutex m;
+   // not atomic: ThreadSanitizer reports the race if the work is not serialized
+   long total = 0;
+   auto work = [&](auto s) { return then(std::move(s), [&] { return ++total; }); };
+
+   std::latch latch(count);
+   std::vector<std::shared_ptr<void>> ops;
+   ops.reserve(count);
+   {
+      thread_pool pool(4);
+      for (int i = 0; i < count; ++i)
+        ops.push_back(start_operation(locked(pool.scheduler().schedule(), work, m), latch_receiver{&latch}));
+      latch.wait();
+   }
+   CHECK(total == count);
+}
+
+// Completes inline, but reports the scheduler of the pool, like a sender
+// completing on a worker.
+struct on_worker_sender
+{
+   template<template<class...> class Tuple, template<class...> class Variant>
+     using value_types = Variant<Tuple<>>;
+   template<template<class...> class Variant>
+     using error_types = Variant<>;
+   static constexpr bool sends_done = false;
+
+   thread_pool::scheduler_type sched;
+
+   template<typename Receiver>
+     requires receiver_of<Receiver>
+   friend auto connect(on_worker_sender, Receiver&& r)
+   {
+      struct operation
+      {
+         std::remove_cvref_t<Receiver> r;
+
+         void start() &&
+         {
+            std::move(r).set_value();
+         }
+      };
+
+      return operation{std::forward<Receiver>(r)};
+   }
+
+   thread_pool::scheduler_type scheduler() const
+   {
+      return sched;
+   }
+};
+
+// A worker blocked in lock() after handing the mutex over to locked() must
+// not be the only one able to resume it: the hand-off is not placed in the
+// LIFO slot of the worker.
+struct relock_receiver
+{
+   thread_pool* pool;
+   async_mutex* m;
+   bool* entered;
+   completion<int>* result;
+   std::shared_ptr<void>* op;
+   std::binary_semaphore* finished;
+
+   void set_value() &&
+   {
+      auto work = [entered = entered](auto s) { return then(std::move(s), [=] { *entered = true; return 0; }); };
+
+      m->lock();
+      *op = start_operation(locked(on_worker_sender{pool->scheduler()}, work, *m), completion_receiver<int>{result});
+      m->unlock();
+      m->lock();
+      CHECK(*entered);
+      m->unlock();
+      finished->release();
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {
+      report_failure("unexpected set_error");
+   }
+
+   void set_done() && noexcept
+   {
+      report_failure("unexpected set_done");
+   }
+};
+
+TEST_CASE(locked, hand_off_is_not_queued_behind_blocked_worker)
+{
+   async_mutex m;
+   bool entered = false;
+   completion<int> result;
+   std::shared_ptr<void> op;
+   std::binary_semaphore finished(0);
+   {
+      thread_pool pool(2);
+      submit(pool.scheduler().schedule(), relock_receiver{&pool, &m, &entered, &result, &op, &finished});
+      if (!finished.try_acquire_for(std::chrono::seconds(30)))
+      {
+         report_failure("worker blocked in lock() was not granted the mutex");
+         std::_Exit(EXIT_FAILURE);
+      }
+   }
+   CHECK(entered);
+}
+
+} // namespace
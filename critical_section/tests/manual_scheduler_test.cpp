@@ -0,0 +1,163 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "manual_scheduler.hpp"
+#include "locked_sender.hpp"
+#include "helpers.hpp"
+#include "test_receivers.hpp"
+#include "test_registry.hpp"
+#include "test_senders.hpp"
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+TEST_CASE(manual_context, run_at_runs_chosen_task)
+{
+   manual_context ctx;
+   std::vector<int> order;
+   for (int i = 0; i < 3; ++i)
+     ctx.enque(void_invocable(std::in_place, [&order, i] { order.push_back(i); }));
+
+   CHECK(!ctx.run_at(3));
+   REQUIRE(ctx.run_at(2));
+   REQUIRE(ctx.run_at(0));
+   REQUIRE(ctx.run_at(0));
+   CHECK(ctx.ready_count() == 0);
+   CHECK(order == std::vector<int>{2, 0, 1});
+}
+
+TEST_CASE(manual_context, schedule_at_waits_for_deadline)
+{
+   manual_context ctx;
+   completion<> result;
+   started_operation op(ctx.scheduler().schedule_at(10ns), completion_receiver<>{&result});
+   CHECK(ctx.timed_count() == 1);
+
+   ctx.advance_by(9ns);
+   CHECK(ctx.run_all() == 0);
+   ctx.advance_by(1ns);
+   CHECK(ctx.run_all() == 1);
+   CHECK(result.count == 1);
+}
+
+TEST_CASE(manual_context, schedule_after_is_measured_from_start)
+{
+   manual_context ctx;
+   auto sender = ctx.scheduler().schedule_after(10ns);
+   ctx.advance_by(100ns);
+
+   completion<> result;
+   started_operation op(std::move(sender), completion_receiver<>{&result});
+   CHECK(ctx.ready_count() == 0);
+
+   ctx.advance_by(9ns);
+   CHECK(ctx.run_all() == 0);
+   ctx.advance_by(1ns);
+   CHECK(ctx.run_all() == 1);
+   CHECK(result.count == 1);
+}
+
+// locked() operations on the same mutex, with their tasks run in the
+// order given by the choices.
+struct hand_off_run
+{
+   static constexpr std::size_t operation_count = 3;
+
+   manual_context ctx;
+   async_mutex m;
+   int inside = 0;
+   bool overlapped = false;
+   bool unlocked_inside = false;
+   std::vector<int> entered;
+   std::array<completion<int>, operation_count> results;
+   std::vector<std::shared_ptr<void>> ops;
+
+   explicit hand_off_run(std::vector<std::size_t> const& choices)
+   {
+      for (std::size_t i = 0; i < operation_count; ++i)
+      {
+         // the section is left after a suspension, when the other ready
+         // tasks may run
+         auto work = [this, i](auto s) {
+            auto entered_section = then(std::move(s), [this, i] {
+               overlapped |= inside++ != 0;
+               entered.push_back(static_cast<int>(i));
+               check_locked();
+               return static_cast<int>(i);
+            });
+            return then(hop(std::move(entered_section), ctx.scheduler()), [this, i] {
+               check_locked();
+               --inside;
+               return static_cast<int>(i);
+            });
+         };
+         ops.push_back(start_operation(locked(ctx.scheduler().schedule(), work, m),
+                                       completion_receiver<int>{&results[i]}));
+      }
+
+      for (std::size_t choice : choices)
+        ctx.run_at(choice);
+   }
+
+   void check_locked()
+   {
+      if (m.try_lock())
+      {
+         unlocked_inside = true;
+         m.unlock();
+      }
+   }
+};
+
+// Explores every order of the ready tasks, so each lock attempt is run
+// both before and after the unlock of the current owner, that hands the
+// mutex to the waiting operation.
+TEST_CASE(manual_context, run_at_explores_lock_hand_off)
+{
+   std::size_t schedules = 0;
+   std::vector<std::vector<std::size_t>> pending{{}};
+   while (!pending.empty())
+   {
+      std::vector<std::size_t> choices = std::move(pending.back());
+      pending.pop_back();
+
+      hand_off_run run(choices);
+      std::size_t ready = run.ctx.ready_count();
+      for (std::size_t i = 0; i < ready; ++i)
+      {
+         pending.push_back(choices);
+         pending.back().push_back(i);
+      }
+      if (ready != 0)
+        continue;
+
+      ++schedules;
+      CHECK(!run.overlapped);
+      CHECK(!run.unlocked_inside);
+      CHECK(run.entered.size() == hand_off_run::operation_count);
+      for (std::size_t i = 0; i < hand_off_run::operation_count; ++i)
+      {
+         CHECK(run.results[i].count == 1);
+         CHECK(run.results[i].values == std::tuple(static_cast<int>(i)));
+      }
+      REQUIRE(run.m.try_lock());
+      run.m.unlock();
+   }
+   // all orders of the initial tasks, and of the resumptions after hand-off
+   CHECK(schedules >= 6);
+}
+
+} // namespace
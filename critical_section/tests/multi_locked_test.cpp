@@ -0,0 +1,181 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "locked_sender.hpp"
+#include "helpers.hpp"
+#include "manual_scheduler.hpp"
+#include "thread_pool.hpp"
+#include "test_receivers.hpp"
+#include "test_registry.hpp"
+#include "test_senders.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+TEST_CASE(multi_locked, locks_all_mutexes_once)
+{
+   async_mutex a, b;
+   auto work = [](auto s) { return then(std::move(s), [](int v) { return v + 1; }); };
+
+   completion<int> result;
+   started_operation op(locked(just10_sender{}, work, a, b, a), completion_receiver<int>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(result.values == std::tuple(11));
+
+   REQUIRE(a.try_lock());
+   REQUIRE(b.try_lock());
+   a.unlock();
+   b.unlock();
+}
+
+TEST_CASE(multi_locked, waits_for_every_mutex)
+{
+   async_mutex a, b;
+   bool entered = false;
+   auto work = [&](auto s) { return then(std::move(s), [&](int v) { entered = true; return v; }); };
+
+   REQUIRE(b.try_lock());
+   completion<int> result;
+   started_operation op(locked(just10_sender{}, work, a, b), completion_receiver<int>{&result});
+   CHECK(!entered);
+   // a is held by the waiting operation
+   CHECK(!a.try_lock());
+
+   b.unlock();
+   CHECK(entered);
+   REQUIRE(result.count == 1);
+   REQUIRE(a.try_lock());
+   a.unlock();
+}
+
+// Random transfers between the balances guarded by the mutexes, that are
+// locked in any order and together with a std::lock_guard user; the sum of
+// the balances is preserved only if every transfer is serialized with all
+// accesses to the balances it touches.
+TEST_CASE(multi_locked, random_cross_transfers)
+{
+   constexpr std::size_t mutex_count = 3;
+   constexpr int transfers = 3000;
+   constexpr long initial = 1000;
+
+   std::array<async_mutex, mutex_count> mutexes;
+   // not atomic: ThreadSanitizer reports the race if the accesses are not serialized
+   std::array<long, mutex_count> balances;
+   balances.fill(initial);
+
+   struct transfer
+   {
+      std::array<long, mutex_count>* balances;
+      std::size_t from, to, via;
+
+      int operator()() const
+      {
+         auto& b = *balances;
+         b[from] -= 2;
+         b[to] += 1;
+         b[via] += 1;
+         return 0;
+      }
+   };
+
+   std::mt19937 gen(2020);
+   std::uniform_int_distribution<std::size_t> pick(0, mutex_count - 1);
+
+   // by the std::lock_guard user
+   long deposited = 0;
+
+   std::latch latch(transfers);
+   std::vector<std::shared_ptr<void>> ops;
+   ops.reserve(transfers);
+   {
+      thread_pool pool(4);
+      std::atomic<bool> stop{false};
+      std::latch guard_started(1);
+      std::jthread guard_user([&] {
+         guard_started.count_down();
+         for (std::size_t i = 0; !stop.load(std::memory_order_relaxed); ++i)
+         {
+            std::lock_guard<async_mutex> lock(mutexes[i % mutex_count]);
+            balances[i % mutex_count] += 1;
+            ++deposited;
+         }
+      });
+      guard_started.wait();
+
+      for (int i = 0; i < transfers; ++i)
+      {
+         transfer t{&balances, pick(gen), pick(gen), pick(gen)};
+         auto work = [t](auto s) { return then(std::move(s), t); };
+         if (i % 2 == 0)
+           ops.push_back(start_operation(
+             locked(pool.scheduler().schedule(), work, mutexes[t.from], mutexes[t.to], mutexes[t.via]),
+             latch_receiver{&latch}));
+         else
+           ops.push_back(start_operation(
+             locked(pool.scheduler().schedule(), work, mutexes[t.via], mutexes[t.from], mutexes[t.to]),
+             latch_receiver{&latch}));
+      }
+      latch.wait();
+      stop = true;
+   }
+
+   long sum = 0;
+   for (long b : balances)
+     sum += b;
+   CHECK(sum == initial * long(mutex_count) + deposited);
+}
+
+// Operations locking the same mutexes in opposite orders, with the tasks of
+// the context run in a random order.
+TEST_CASE(multi_locked, opposite_orders_do_not_deadlock)
+{
+   for (std::uint64_t seed = 0; seed < 200; ++seed)
+   {
+      manual_context ctx(seed);
+      async_mutex a, b;
+      int inside = 0;
+      int overlapped = 0;
+      // the section is left after a suspension, when the other ready
+      // tasks may run
+      auto work = [&](auto s) {
+         auto entered = then(std::move(s), [&] { return overlapped += inside++ != 0; });
+         return then(hop(std::move(entered), ctx.scheduler()), [&] {
+            --inside;
+            return 0;
+         });
+      };
+
+      std::array<completion<int>, 6> results;
+      std::vector<std::shared_ptr<void>> ops;
+      for (std::size_t i = 0; i < results.size(); ++i)
+        if (i % 2 == 0)
+          ops.push_back(start_operation(locked(ctx.scheduler().schedule(), work, a, b),
+                                        completion_receiver<int>{&results[i]}));
+        else
+          ops.push_back(start_operation(locked(ctx.scheduler().schedule(), work, b, a),
+                                        completion_receiver<int>{&results[i]}));
+      ctx.run_all_random();
+
+      for (auto& result : results)
+        CHECK(result.count == 1);
+      CHECK(overlapped == 0);
+   }
+}
+
+} // namespace
@@ -0,0 +1,104 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "pool_allocator.hpp"
+#include "allocation_counter.hpp"
+#include "test_registry.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t block_size = 256;
+
+TEST_CASE(pool_resource, recycles_freed_blocks)
+{
+   std::vector<void*> blocks(2 * pool_resource::batch_size);
+   auto round = [&] {
+      for (void*& b : blocks)
+        b = pool_resource::allocate(block_size);
+      for (void* b : blocks)
+        pool_resource::deallocate(b, block_size);
+   };
+
+   round();
+   std::size_t before = allocation_count();
+   for (int i = 0; i < 100; ++i)
+     round();
+   CHECK(allocation_count() == before);
+}
+
+TEST_CASE(pool_resource, recycles_blocks_freed_on_other_thread)
+{
+   std::vector<void*> blocks(4 * pool_resource::batch_size);
+   auto round = [&] {
+      for (void*& b : blocks)
+        b = pool_resource::allocate(block_size);
+      std::thread([&] {
+         for (void* b : blocks)
+           pool_resource::deallocate(b, block_size);
+      }).join();
+   };
+
+   round();
+   std::size_t upstream = pool_resource::stats().upstream_allocations;
+   for (int i = 0; i < 20; ++i)
+     round();
+   // blocks moved to the depot are taken back, instead of new slabs
+   CHECK(pool_resource::stats().upstream_allocations == upstream);
+}
+
+// Destroyed after the cache of the thread, as it is constructed before it.
+struct late_pool_user
+{
+   void* freed = nullptr;
+   std::vector<void*>* kept = nullptr;
+
+   ~late_pool_user()
+   {
+      pool_resource::deallocate(freed, block_size);
+      for (int i = 0; i < 4; ++i)
+        kept->push_back(pool_resource::allocate(block_size));
+   }
+};
+
+TEST_CASE(pool_resource, serves_thread_locals_destroyed_after_cache)
+{
+   std::vector<void*> kept;
+   kept.reserve(4);
+   std::thread([&] {
+      thread_local late_pool_user user;
+      user.kept = &kept;
+      user.freed = pool_resource::allocate(block_size);
+      // leave some blocks in the cache, that are moved to the depot
+      void* cached = pool_resource::allocate(block_size);
+      pool_resource::deallocate(cached, block_size);
+   }).join();
+   REQUIRE(kept.size() == 4);
+
+   // the blocks handed out after the cache was destroyed are not in the depot
+   std::vector<void*> taken;
+   std::thread([&] {
+      for (std::size_t i = 0; i < 8 * pool_resource::batch_size; ++i)
+        taken.push_back(pool_resource::allocate(block_size));
+      for (void* b : taken)
+        pool_resource::deallocate(b, block_size);
+   }).join();
+   for (void* b : kept)
+     CHECK(std::find(taken.begin(), taken.end(), b) == taken.end());
+
+   for (void* b : kept)
+     pool_resource::deallocate(b, block_size);
+}
+
+} // namespace
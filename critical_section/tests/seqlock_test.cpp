@@ -0,0 +1,225 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "seqlock.hpp"
+#include "helpers.hpp"
+#include "thread_pool.hpp"
+#include "test_receivers.hpp"
+#include "test_registry.hpp"
+
+#include <atomic>
+#include <exception>
+#include <latch>
+#include <memory>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+namespace {
+
+TEST_CASE(seqlock, optimistic_read_does_not_lock)
+{
+   seqlock l;
+   std::atomic<int> data{5};
+   auto read = [&](int v) noexcept { return v + data.load(std::memory_order_relaxed); };
+
+   completion<int> result;
+   started_operation op(optimistic_locked(just10_sender{}, read, l), completion_receiver<int>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(result.values == std::tuple(15));
+   CHECK(l.sequence.load() == 0);
+}
+
+TEST_CASE(seqlock, writer_makes_sequence_odd_while_held)
+{
+   seqlock l;
+   std::size_t inside = 1;
+   auto work = [&](auto s) { return then(std::move(s), [&](int v) { inside = l.sequence.load(); return v; }); };
+
+   completion<int> result;
+   started_operation op(locked(just10_sender{}, work, l), completion_receiver<int>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(result.values == std::tuple(10));
+   CHECK(inside == 1);
+   CHECK(l.sequence.load() == 2);
+}
+
+TEST_CASE(seqlock, optimistic_read_waits_for_writer_after_attempts)
+{
+   seqlock l;
+   std::atomic<int> data{0};
+   auto read = [&](int v) noexcept { return v + data.load(std::memory_order_relaxed); };
+
+   // a writer in the middle of the update
+   REQUIRE(l.mutex.try_lock());
+   l.sequence.store(1);
+
+   completion<int> result;
+   started_operation op(optimistic_locked(just10_sender{}, read, l, 3), completion_receiver<int>{&result});
+   CHECK(result.count == 0);
+
+   data.store(1);
+   l.sequence.store(2);
+   l.mutex.unlock();
+   REQUIRE(result.count == 1);
+   CHECK(result.values == std::tuple(11));
+   REQUIRE(l.mutex.try_lock());
+   l.mutex.unlock();
+}
+
+// Writers keep both halves equal; a reader must never deliver a torn pair.
+TEST_CASE(seqlock, concurrent_reads_are_consistent)
+{
+   constexpr int writes = 2000;
+   constexpr int reads = 4000;
+
+   seqlock l;
+   std::atomic<long> first{0}, second{0};
+   auto write = [&](auto s) {
+      return then(std::move(s), [&] {
+         long next = first.load(std::memory_order_relaxed) + 1;
+         first.store(next, std::memory_order_relaxed);
+         second.store(next, std::memory_order_relaxed);
+         return 0;
+      });
+   };
+   auto read = [&](auto...) noexcept {
+      long a = first.load(std::memory_order_relaxed);
+      long b = second.load(std::memory_order_relaxed);
+      return a == b;
+   };
+
+   std::vector<completion<bool>> results(reads);
+   std::latch latch(writes + reads);
+   std::vector<std::shared_ptr<void>> ops;
+   ops.reserve(writes + reads);
+   {
+      thread_pool pool(4);
+      // a write after every two reads
+      for (int w = 0, r = 0; w < writes || r < reads;)
+      {
+         if (w < writes && (r == reads || r >= 2 * w))
+         {
+            ops.push_back(start_operation(locked(pool.scheduler().schedule(), write, l), latch_receiver{&latch}));
+            ++w;
+         }
+         else
+         {
+            ops.push_back(start_operation(optimistic_locked(pool.scheduler().schedule(), read, l),
+                                          completion_receiver<bool>{&results[r], &latch}));
+            ++r;
+         }
+      }
+      latch.wait();
+   }
+
+   for (auto& result : results)
+   {
+      REQUIRE(result.count == 1);
+      CHECK(result.values == std::tuple(true));
+   }
+   CHECK(first.load() == writes);
+   CHECK(l.sequence.load() == 2 * writes);
+}
+
+TEST_CASE(seqlock, optimistic_read_of_void_function)
+{
+   seqlock l;
+   int seen = 0;
+   auto read = [&](int v) noexcept { seen = v; };
+
+   completion<> result;
+   started_operation op(optimistic_locked(just10_sender{}, read, l), completion_receiver<>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(result.values.has_value());
+   CHECK(seen == 10);
+}
+
+// Sends no errors itself, but the fallback read is resumed on the scheduler.
+struct nothrow_just10_sender
+{
+   template<template<class...> class Tuple, template<class...> class Variant>
+     using value_types = Variant<Tuple<int>>;
+   template<template<class...> class Variant>
+     using error_types = Variant<>;
+   static constexpr bool sends_done = false;
+
+   template<typename Receiver>
+     requires receiver_of<Receiver, int>
+   friend auto connect(nothrow_just10_sender, Receiver&& r)
+   {
+      struct operation
+      {
+         std::remove_cvref_t<Receiver> r;
+
+         void start() &&
+         {
+            std::move(r).set_value(10);
+         }
+      };
+
+      return operation{std::forward<Receiver>(r)};
+   }
+
+   inline_scheduler scheduler() const
+   {
+      return {};
+   }
+};
+
+// The errors of the scheduler resuming the fallback read are advertised, so
+// the result can be stored by capture_args().
+template<typename... Errors>
+using error_list = std::tuple<Errors...>;
+
+using nothrow_read_sender = decltype(optimistic_locked(nothrow_just10_sender{}, std::declval<int(*)(int) noexcept>(),
+                                                       std::declval<seqlock&>()));
+static_assert(std::is_same_v<sender_traits<nothrow_read_sender>::value_types<std::tuple, std::variant>,
+                             std::variant<std::tuple<int>>>);
+#if __cpp_exceptions
+static_assert(std::is_same_v<sender_traits<nothrow_read_sender>::error_types<error_list>,
+                             error_list<std::exception_ptr, std::exception_ptr>>);
+#endif
+
+struct read_result_receiver
+{
+   int* value;
+
+   template<typename Result>
+   void set_value(Result& res) &&
+   {
+      res.visit([this](auto& alternative) {
+         if constexpr (requires { std::get<0>(alternative.value) + 0; })
+           *value = std::get<0>(alternative.value);
+      });
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {
+      report_failure("capture_args() delivers errors as values");
+   }
+
+   void set_done() && noexcept
+   {
+      report_failure("capture_args() delivers done as a value");
+   }
+};
+
+TEST_CASE(seqlock, optimistic_read_result_can_be_captured)
+{
+   seqlock l;
+   int value = 0;
+   auto read = [](int v) noexcept { return v + 1; };
+   started_operation op(capture_args(optimistic_locked(nothrow_just10_sender{}, read, l)), read_result_receiver{&value});
+   CHECK(value == 11);
+}
+
+} // namespace
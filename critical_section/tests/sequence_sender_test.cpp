@@ -0,0 +1,251 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "sequence_sender.hpp"
+#include "helpers.hpp"
+#include "locked_sender.hpp"
+#include "scheduled_sequence.hpp"
+#include "thread_pool.hpp"
+#include "test_receivers.hpp"
+#include "test_registry.hpp"
+
+#include <exception>
+#include <latch>
+#include <memory>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+// Collects the items of the sequence into a vector.
+auto collect_into(std::vector<int>& items)
+{
+   return [&items](auto item) { return then(std::move(item), [&items](int v) { items.push_back(v); return v; }); };
+}
+
+// connect() checks that the receiver accepts the values, or the items
+using for_each_ints = for_each_sender<iota_sequence_sender<int>, decltype(collect_into(std::declval<std::vector<int>&>()))>;
+static_assert(sender_to<for_each_ints, completion_receiver<>>);
+static_assert(!sender_to<for_each_ints, completion_receiver<int>>);
+static_assert(!sender_to<take_sender<iota_sequence_sender<int>>, completion_receiver<>>);
+static_assert(!sender_to<buffer_sender<iota_sequence_sender<int>>, completion_receiver<>>);
+
+TEST_CASE(sequence_sender, for_each_visits_all_items)
+{
+   std::vector<int> items;
+   completion<> result;
+   started_operation op(for_each(iota_sequence(0, 5), collect_into(items)), completion_receiver<>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(result.values.has_value());
+   CHECK(items == std::vector<int>{0, 1, 2, 3, 4});
+}
+
+TEST_CASE(sequence_sender, transform_applies_function)
+{
+   std::vector<int> items;
+   completion<> result;
+   auto doubled = transform(iota_sequence(0, 3), [](int v) { return 2 * v; });
+   started_operation op(for_each(std::move(doubled), collect_into(items)), completion_receiver<>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(result.values.has_value());
+   CHECK(items == std::vector<int>{0, 2, 4});
+}
+
+TEST_CASE(sequence_sender, take_stops_after_count_items)
+{
+   std::vector<int> items;
+   completion<> result;
+   started_operation op(for_each(take(iota_sequence(0, 100), 3), collect_into(items)), completion_receiver<>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(result.values.has_value());
+   CHECK(items == std::vector<int>{0, 1, 2});
+}
+
+TEST_CASE(sequence_sender, take_zero_does_not_pull_items)
+{
+   int pulled = 0;
+   auto counted = transform(iota_sequence(0, 100), [&](int v) { ++pulled; return v; });
+
+   std::vector<int> items;
+   completion<> result;
+   started_operation op(for_each(take(std::move(counted), 0), collect_into(items)), completion_receiver<>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(result.values.has_value());
+   CHECK(pulled == 0);
+   CHECK(items.empty());
+}
+
+TEST_CASE(sequence_sender, buffer_delivers_all_items)
+{
+   for (std::size_t count : {1, 4, 100})
+   {
+      std::vector<int> items;
+      completion<> result;
+      started_operation op(for_each(buffer(iota_sequence(0, 10), count), collect_into(items)),
+                           completion_receiver<>{&result});
+      REQUIRE(result.count == 1);
+      CHECK(result.values.has_value());
+      CHECK(items == std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+   }
+}
+
+TEST_CASE(sequence_sender, buffer_of_zero_holds_single_item)
+{
+   std::vector<int> items;
+   completion<> result;
+   started_operation op(for_each(buffer(iota_sequence(0, 10), 0), collect_into(items)), completion_receiver<>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(result.values.has_value());
+   CHECK(items.size() == 10);
+}
+
+TEST_CASE(sequence_sender, buffer_forwards_stop_of_take)
+{
+   std::vector<int> items;
+   completion<> result;
+   started_operation op(for_each(take(buffer(iota_sequence(0, 100), 4), 2), collect_into(items)),
+                        completion_receiver<>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(result.values.has_value());
+   CHECK(items == std::vector<int>{0, 1});
+}
+
+TEST_CASE(sequence_sender, for_each_runs_items_through_locked)
+{
+   async_mutex m;
+   std::vector<int> items;
+   auto work = [&](auto s) { return then(std::move(s), [&](int v) { items.push_back(v); return v; }); };
+   auto each_locked = [&](auto item) { return locked(std::move(item), work, m); };
+
+   completion<> result;
+   started_operation op(for_each(iota_sequence(0, 5), each_locked), completion_receiver<>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(result.values.has_value());
+   CHECK(items == std::vector<int>{0, 1, 2, 3, 4});
+   REQUIRE(m.try_lock());
+   m.unlock();
+}
+
+// Two sequences contend for the mutex, so their items wait for the lock
+// and are resumed on the pool, and the producers continue from there.
+TEST_CASE(sequence_sender, items_complete_asynchronously_on_pool)
+{
+   constexpr int count = 1000;
+   async_mutex m;
+   std::vector<int> items[2];
+   bool on_pool = false;
+   completion<> results[2];
+   std::latch latch(2);
+   std::shared_ptr<void> ops[2];
+   {
+      thread_pool pool(2);
+      auto sequence_into = [&](std::vector<int>& out) {
+         auto work = [&](auto s) {
+            return then(std::move(s), [&](int v) {
+               out.push_back(v);
+               on_pool |= pool.scheduler().on_same_worker();
+               return v;
+            });
+         };
+         return for_each(schedule_items_on(iota_sequence(0, count), pool.scheduler()),
+                         [&m, work](auto item) { return locked(std::move(item), work, m); });
+      };
+
+      REQUIRE(m.try_lock());
+      for (int i = 0; i < 2; ++i)
+        ops[i] = start_operation(sequence_into(items[i]), completion_receiver<>{&results[i], &latch});
+      CHECK(results[0].count == 0);
+      CHECK(results[1].count == 0);
+      m.unlock();
+      latch.wait();
+   }
+
+   std::vector<int> expected(count);
+   std::iota(expected.begin(), expected.end(), 0);
+   for (int i = 0; i < 2; ++i)
+   {
+      REQUIRE(results[i].count == 1);
+      CHECK(results[i].values.has_value());
+      CHECK(items[i] == expected);
+   }
+   CHECK(on_pool);
+}
+
+// Sequence of a single item, that fails after it with an error of its own
+// type, that is not std::exception_ptr.
+struct failing_sequence_sender
+{
+   template<template<class...> class Tuple, template<class...> class Variant>
+     using value_types = Variant<Tuple<int>>;
+   template<template<class...> class Variant>
+     using error_types = Variant<int>;
+   static constexpr bool sends_done = false;
+
+   template<typename Receiver>
+     requires sequence_receiver_of<Receiver, int>
+   friend auto connect(failing_sequence_sender, Receiver&& r)
+   {
+      struct operation_type : sequence_emitter<operation_type, std::remove_cvref_t<Receiver>, int>
+      {
+         std::remove_cvref_t<Receiver> r;
+
+         explicit operation_type(Receiver&& r) : r(std::forward<Receiver>(r))
+         {}
+
+         operation_type(operation_type&&) = delete;
+
+         void start() &&
+         {
+            if (this->emit(r, 1))
+              resume();
+         }
+
+         void resume()
+         {
+            this->next_op.reset();
+            std::move(r).set_error(7);
+         }
+      };
+
+      return operation_type(std::forward<Receiver>(r));
+   }
+
+   inline_scheduler scheduler() const
+   {
+      return {};
+   }
+};
+
+TEST_CASE(sequence_sender, buffer_forwards_upstream_error_type)
+{
+   static_assert(std::is_same_v<sender_traits<buffer_sender<failing_sequence_sender>>::error_types<type_list>,
+                                type_list<int, std::exception_ptr>>);
+
+   std::vector<int> items;
+   completion<> result;
+   started_operation op(for_each(buffer(failing_sequence_sender{}, 4), collect_into(items)),
+                        completion_receiver<>{&result});
+   REQUIRE(result.count == 1);
+   CHECK(items == std::vector<int>{1});
+   REQUIRE(result.error != nullptr);
+   int error = 0;
+   try
+   {
+      std::rethrow_exception(result.error);
+   }
+   catch (int e)
+   {
+      error = e;
+   }
+   CHECK(error == 7);
+}
+
+} // namespace
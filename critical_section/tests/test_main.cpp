@@ -0,0 +1,71 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "test_registry.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct test_case
+{
+   std::string name;
+   test_function fn;
+};
+
+std::vector<test_case>& test_cases()
+{
+   static std::vector<test_case> cases;
+   return cases;
+}
+
+std::atomic<int> failures{0};
+std::mutex output;
+
+} // namespace
+
+bool register_test_case(std::string_view suite, std::string_view name, test_function fn)
+{
+   test_cases().push_back({std::string(suite) + "." + std::string(name), fn});
+   return true;
+}
+
+void report_failure(std::string_view message, std::source_location loc)
+{
+   failures.fetch_add(1, std::memory_order_relaxed);
+   std::lock_guard<std::mutex> lock(output);
+   std::fprintf(stderr, "%s:%u: %.*s\n", loc.file_name(), static_cast<unsigned>(loc.line()),
+                static_cast<int>(message.size()), message.data());
+}
+
+// Runs the test cases whose name contains the first argument, or all of them.
+int main(int argc, char* argv[])
+{
+   std::string_view filter = argc > 1 ? argv[1] : "";
+   int failed_cases = 0;
+   for (test_case const& tc : test_cases())
+   {
+      if (tc.name.find(filter) == std::string::npos)
+        continue;
+
+      std::printf("[ RUN  ] %s\n", tc.name.c_str());
+      std::fflush(stdout);
+      int before = failures.load();
+      tc.fn();
+      bool passed = failures.load() == before;
+      failed_cases += !passed;
+      std::printf("[ %s ] %s\n", passed ? " OK " : "FAIL", tc.name.c_str());
+   }
+   return failed_cases == 0 ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#pragma once
+#include "concepts.hpp"
+#include "started_operation.hpp"
+#include "test_registry.hpp"
+
+#include <exception>
+#include <latch>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// How an operation completed, filled by completion_receiver.
+template<typename... Values>
+struct completion
+{
+   std::optional<std::tuple<Values...>> values;
+   std::exception_ptr error;
+   bool done = false;
+   int count = 0;
+};
+
+// Records the completion, and counts down the latch if given, so the
+// completion can be awaited when the operation runs on another thread.
+template<typename... Values>
+struct completion_receiver
+{
+   completion<Values...>* result;
+   std::latch* latch = nullptr;
+
+   void set_value(Values... vals) &&
+   {
+      result->values.emplace(std::move(vals)...);
+      finish();
+   }
+
+   template<typename Error>
+   void set_error(Error&& err) && noexcept
+   {
+      if constexpr (std::is_same_v<std::remove_cvref_t<Error>, std::exception_ptr>)
+        result->error = std::forward<Error>(err);
+      else
+        result->error = std::make_exception_ptr(std::forward<Error>(err));
+      finish();
+   }
+
+   void set_done() && noexcept
+   {
+      result->done = true;
+      finish();
+   }
+
+private:
+   void finish()
+   {
+      ++result->count;
+      if (latch)
+        latch->count_down();
+   }
+};
+
+// Counts down the latch on a value, and fails the test on an error or done.
+struct latch_receiver
+{
+   std::latch* latch;
+
+   template<typename... Args>
+   void set_value(Args&&...) && noexcept
+   {
+      latch->count_down();
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {
+      report_failure("unexpected set_error");
+      latch->count_down();
+   }
+
+   void set_done() && noexcept
+   {
+      report_failure("unexpected set_done");
+      latch->count_down();
+   }
+};
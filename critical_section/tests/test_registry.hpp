@@ -0,0 +1,45 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#pragma once
+
+#include <source_location>
+#include <string_view>
+
+// Minimal test registry, run by test_main.cpp: test cases are registered
+// by TEST_CASE, and report failures with CHECK (continues the test case)
+// and REQUIRE (returns from it). Failures may be reported from any thread.
+
+using test_function = void (*)();
+
+bool register_test_case(std::string_view suite, std::string_view name, test_function fn);
+
+void report_failure(std::string_view message, std::source_location loc = std::source_location::current());
+
+#define TEST_CASE(suite, name)                                                        \
+   static void suite##_##name();                                                      \
+   [[maybe_unused]] static bool const suite##_##name##_registered =                   \
+     register_test_case(#suite, #name, &suite##_##name);                              \
+   static void suite##_##name()
+
+#define CHECK(...)                                                                    \
+   do {                                                                               \
+     if (!(__VA_ARGS__))                                                              \
+       report_failure("CHECK(" #__VA_ARGS__ ") failed");                              \
+   } while (false)
+
+#define REQUIRE(...)                                                                  \
+   do {                                                                               \
+     if (!(__VA_ARGS__))                                                              \
+     {                                                                                \
+       report_failure("REQUIRE(" #__VA_ARGS__ ") failed");                            \
+       return;                                                                        \
+     }                                                                                \
+   } while (false)
@@ -0,0 +1,117 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#pragma once
+#include "concepts.hpp"
+
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+template<sender Sender, scheduler Scheduler, receiver Receiver>
+struct hop_operation
+{
+   struct resume_receiver
+   {
+      hop_operation* op;
+
+      void set_value() && noexcept
+      {
+         set_value_or_error(std::move(op->r));
+      }
+
+      template<typename Error>
+      void set_error(Error&& err) && noexcept
+      {
+         std::move(op->r).set_error(std::forward<Error>(err));
+      }
+
+      void set_done() && noexcept
+      {
+         std::move(op->r).set_done();
+      }
+   };
+
+   struct upstream_receiver
+   {
+      hop_operation* op;
+
+      template<typename... Args>
+      void set_value(Args&&...) && noexcept
+      {
+         op->resume.emplace(init_from_invoke{[&] {
+            return connect(op->sched.schedule(), resume_receiver{op});
+         }});
+         std::move(*op->resume).start();
+      }
+
+      template<typename Error>
+      void set_error(Error&& err) && noexcept
+      {
+         std::move(op->r).set_error(std::forward<Error>(err));
+      }
+
+      void set_done() && noexcept
+      {
+         std::move(op->r).set_done();
+      }
+   };
+
+   using schedule_sender = decltype(std::declval<Scheduler&>().schedule());
+
+   explicit hop_operation(Sender&& s, Scheduler sched, Receiver r)
+     : r(std::move(r)), sched(std::move(sched)),
+       upstream(init_from_invoke{[&] { return connect(std::move(s), upstream_receiver{this}); }})
+   {}
+
+   hop_operation(hop_operation&&) = delete;
+
+   void start() &&
+   {
+      std::move(upstream).start();
+   }
+
+   Receiver r;
+   Scheduler sched;
+   operation_state_type<Sender, upstream_receiver> upstream;
+   std::optional<operation_state_type<schedule_sender, resume_receiver>> resume;
+};
+
+// Completes with no values, after the values of the sender are dropped and
+// the work is rescheduled on the scheduler, so the other ready tasks may run
+// in between. The effects of the sender and of its continuation are then
+// separated by a real suspension point.
+template<sender Sender, scheduler Scheduler>
+struct hop_sender
+{
+   template<template<class...> class Tuple, template<class...> class Variant>
+     using value_types = Variant<Tuple<>>;
+   template<template<class...> class Variant>
+     using error_types = Variant<std::exception_ptr>;
+   static constexpr bool sends_done = true;
+
+   Sender s;
+   Scheduler sched;
+
+   template<typename Receiver>
+     requires receiver_of<Receiver>
+   friend auto connect(hop_sender h, Receiver&& r)
+   {
+      return hop_operation<Sender, Scheduler, std::remove_cvref_t<Receiver>>(
+        std::move(h.s), std::move(h.sched), std::forward<Receiver>(r));
+   }
+};
+
+template<sender Sender, scheduler Scheduler>
+auto hop(Sender s, Scheduler sched)
+{
+   return hop_sender<Sender, Scheduler>{std::move(s), std::move(sched)};
+}
@@ -0,0 +1,203 @@
+/**
+ * Copyright 2020 (c) Tomasz Kamiński
+ *
+ * Use, modification, and distribution is subject to the Boost Software
+ * License, Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ *    Authors: Tomasz Kamiński (tomaszkam@gmail.com)
+ */
+
+#include "thread_pool.hpp"
+#include "test_receivers.hpp"
+#include "test_registry.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <latch>
+#include <semaphore>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+struct worker_receiver
+{
+   thread_pool* pool;
+   std::thread::id* id;
+   bool* on_worker;
+   std::latch* latch;
+
+   void set_value() &&
+   {
+      *id = std::this_thread::get_id();
+      *on_worker = pool->scheduler().on_same_worker();
+      latch->count_down();
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {
+      report_failure("unexpected set_error");
+      latch->count_down();
+   }
+
+   void set_done() && noexcept
+   {
+      report_failure("unexpected set_done");
+      latch->count_down();
+   }
+};
+
+// Throws from set_value, that must be reported to set_error of the same receiver.
+struct throwing_receiver
+{
+   bool* failed;
+   std::latch* latch;
+
+   void set_value() &&
+   {
+      throw std::runtime_error("set_value failed");
+   }
+
+   void set_error(std::exception_ptr) && noexcept
+   {
+      *failed = true;
+      latch->count_down();
+   }
+
+   void set_done() && noexcept
+   {
+      report_failure("unexpected set_done");
+      latch->count_down();
+   }
+};
+
+TEST_CASE(thread_pool, exception_of_set_value_is_passed_to_set_error)
+{
+   bool failed = false;
+   std::latch latch(1);
+   thread_pool pool(1);
+   submit(pool.scheduler().schedule(), throwing_receiver{&failed, &latch});
+   latch.wait();
+   CHECK(failed);
+}
+
+TEST_CASE(thread_pool, runs_scheduled_work_on_worker)
+{
+   std::thread::id id;
+   bool on_worker = false;
+   std::latch latch(1);
+   thread_pool pool(2);
+   CHECK(!pool.scheduler().on_same_worker());
+
+   submit(pool.scheduler().schedule(), worker_receiver{&pool, &id, &on_worker, &latch});
+   latch.wait();
+   CHECK(id != std::this_thread::get_id());
+   CHECK(on_worker);
+}
+
+TEST_CASE(thread_pool, runs_all_submitted_tasks)
+{
+   constexpr int count = 10000;
+   std::latch latch(count);
+   thread_pool pool(4);
+   for (int i = 0; i < count; ++i)
+     submit(pool.scheduler().schedule(), latch_receiver{&latch});
+   latch.wait();
+}
+
+// Each task submits the next one from a worker, through the LIFO slot of the
+// worker, and every third one also a task that displaces it to the shared queue.
+struct chain_receiver
+{
+   thread_pool* pool;
+   std::atomic<int>* remaining;
+   std::latch* latch;
+   int depth;
+
+   void set_value() &&
+   {
+      remaining->fetch_sub(1, std::memory_order_relaxed);
+      if (depth > 0)
+      {
+        submit(pool->scheduler().schedule(), chain_receiver{pool, remaining, latch, depth - 1});
+        if (depth % 3 == 0)
+          submit(pool->scheduler().schedule(), chain_receiver{pool, remaining, latch, 0});
+      }
+      latch->count_down();
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {
+      report_failure("unexpected set_error");
+   }
+
+   void set_done() && noexcept
+   {
+      report_failure("unexpected set_done");
+   }
+};
+
+TEST_CASE(thread_pool, runs_tasks_submitted_from_workers)
+{
+   constexpr int depth = 3000;
+   constexpr int count = depth + 1 + depth / 3;
+   std::atomic<int> remaining{count};
+   std::latch latch(count);
+   thread_pool pool(4);
+   submit(pool.scheduler().schedule(), chain_receiver{&pool, &remaining, &latch, depth});
+   latch.wait();
+   CHECK(remaining.load() == 0);
+}
+
+// Blocks the worker until the tasks it schedules have completed, so they
+// must be taken from its LIFO slot by the other workers.
+struct nested_schedule_receiver
+{
+   thread_pool* pool;
+   int count;
+   completion<>* result;
+   std::binary_semaphore* finished;
+
+   void set_value() &&
+   {
+      for (int i = 0; i < count; ++i)
+        sync_wait(pool->scheduler().schedule(), completion_receiver<>{result});
+      finished->release();
+   }
+
+   template<typename Error>
+   void set_error(Error&&) && noexcept
+   {
+      report_failure("unexpected set_error");
+      finished->release();
+   }
+
+   void set_done() && noexcept
+   {
+      report_failure("unexpected set_done");
+      finished->release();
+   }
+};
+
+TEST_CASE(thread_pool, nested_schedule_from_blocked_worker_completes)
+{
+   constexpr int count = 100;
+   completion<> result;
+   std::binary_semaphore finished(0);
+   thread_pool pool(4);
+   submit(pool.scheduler().schedule(), nested_schedule_receiver{&pool, count, &result, &finished});
+   if (!finished.try_acquire_for(std::chrono::seconds(30)))
+   {
+      report_failure("task scheduled from a blocked worker was not run");
+      std::_Exit(EXIT_FAILURE);
+   }
+   CHECK(result.count == count);
+   CHECK(!result.error);
+}
+
+} // namespace
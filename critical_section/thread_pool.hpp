@@ -11,6 +11,8 @@
 #ifndef GODBOLT_COMPATIBLE
 #pragma once
 #include "concepts.hpp"
+#include "pool_allocator.hpp"
+#include "instrumentation.hpp"
 #endif // GODBOLT_COMPATIBLE
 
 #include <functional>
@@ -19,7 +21,10 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <chrono>
 #include <deque>
+#include <optional>
 #include <vector>
 #include <type_traits>
 
@@ -29,32 +34,77 @@ struct poor_void_invocable_interface
     poor_void_invocable_interface(poor_void_invocable_interface&&) = delete;
 
     virtual void call() && noexcept = 0;
-    virtual ~poor_void_invocable_interface() = default;
+    // destroys and deallocates the object, using the allocator it was created with
+    virtual void destroy() noexcept = 0;
+
+protected:
+    ~poor_void_invocable_interface() = default;
 };
 
-template<typename T>
+template<typename T, typename Allocator>
 struct poor_void_invocable_impl : poor_void_invocable_interface
 {
+    using allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<poor_void_invocable_impl>;
+
     template<typename... Args>
-    explicit poor_void_invocable_impl(std::in_place_t, Args&&... args)
-      : t(std::forward<Args>(args)...)
+    explicit poor_void_invocable_impl(Allocator const& a, std::in_place_t, Args&&... args)
+      : alloc(a), t(std::forward<Args>(args)...)
     {}
 
+    template<typename... Args>
+    static poor_void_invocable_impl* create(Allocator const& a, Args&&... args)
+    {
+        allocator_type alloc(a);
+        auto* p = std::allocator_traits<allocator_type>::allocate(alloc, 1);
+#if __cpp_exceptions
+        try
+        {
+            return ::new (static_cast<void*>(p)) poor_void_invocable_impl(a, std::in_place, std::forward<Args>(args)...);
+        }
+        catch(...)
+        {
+            std::allocator_traits<allocator_type>::deallocate(alloc, p, 1);
+            throw;
+        }
+#else
+        return ::new (static_cast<void*>(p)) poor_void_invocable_impl(a, std::in_place, std::forward<Args>(args)...);
+#endif
+    }
+
     void call() && noexcept override
     {
         return std::invoke(std::move(t));
     }
 
+    void destroy() noexcept override
+    {
+        allocator_type a(alloc);
+        this->~poor_void_invocable_impl();
+        std::allocator_traits<allocator_type>::deallocate(a, this, 1);
+    }
+
 private:
+    [[no_unique_address]] Allocator alloc;
     T t;
 };
 
 struct void_invocable
 {
     void_invocable() = default;
+
+    template<typename Allocator, typename T, typename... Args>
+    void_invocable(std::allocator_arg_t, Allocator const& alloc, std::in_place_type_t<T>, Args&&... args)
+      : val(poor_void_invocable_impl<T, Allocator>::create(alloc, std::forward<Args>(args)...))
+    {}
+
+    template<typename Allocator, typename Arg>
+    void_invocable(std::allocator_arg_t, Allocator const& alloc, std::in_place_t, Arg&& arg)
+      : void_invocable(std::allocator_arg, alloc, std::in_place_type<std::decay_t<Arg>>, std::forward<Arg>(arg))
+    {}
+
     template<typename T, typename... Args>
     explicit void_invocable(std::in_place_type_t<T>, Args&&... args)
-      : val(std::make_unique<poor_void_invocable_impl<T>>(std::in_place, std::forward<Args>(args)...))
+      : void_invocable(std::allocator_arg, pool_allocator<std::byte>(), std::in_place_type<T>, std::forward<Args>(args)...)
     {}
 
     template<typename Arg>
@@ -70,7 +120,15 @@ struct void_invocable
     }
 
 private:
-    std::unique_ptr<poor_void_invocable_interface> val;
+    struct destroyer
+    {
+        void operator()(poor_void_invocable_interface* p) const noexcept
+        {
+            p->destroy();
+        }
+    };
+
+    std::unique_ptr<poor_void_invocable_interface, destroyer> val;
 };
 
 struct thread_pool
@@ -79,17 +137,36 @@ struct thread_pool
     struct sender_type;
 
     explicit thread_pool(std::size_t n = 1)
+      : local(n)
     {
         workers.reserve(n);
         for (std::size_t i = 0; i < n; ++i)
-          workers.emplace_back(std::bind_front(&thread_pool::runWork, this));
+        {
+          local[i].pool = this;
+          workers.emplace_back(std::bind_front(&thread_pool::runWork, this, i));
+        }
     }
 
+    // Tasks enqueued by a worker of this pool are placed in its LIFO slot
+    // and run by the same worker once the current task completes; the task
+    // that previously occupied the slot is moved to the shared queue. A task
+    // left in the slot for steal_delay (e.g. the worker blocks) is taken
+    // by an idle worker.
     void enque(void_invocable f)
+    {
+      if (current_worker && current_worker->pool == this)
+        return enque_local(*current_worker, std::move(f));
+
+      enque_shared(std::move(f));
+    }
+
+    // Places the task in the shared queue, also when called from a worker,
+    // for tasks that should not wait for the current task of the worker.
+    void enque_shared(void_invocable f)
     {
       {
         std::unique_lock<std::mutex> lock(mutex);
-        tasks.push_back(std::move(f));
+        tasks.push_back({std::move(f), trace_stamp::now()});
       }
       cv.notify_one();
     }
@@ -102,45 +179,159 @@ struct thread_pool
         thread.join();
     }
 
+    pool_instrumentation const& instrumentation() const
+    {
+      return instr;
+    }
+
 private:
-    void runWork(std::stop_token st)
+    struct queued_task
+    {
+        void_invocable fn;
+        [[no_unique_address]] trace_stamp enqueued;
+    };
+
+    struct worker_state
+    {
+        thread_pool* pool = nullptr;
+        // the slot is filled only by the owning worker, but may be
+        // emptied by the other ones (see steal_slot)
+        std::mutex slot_mutex;
+        std::optional<queued_task> lifo_slot;
+        // accessed only by the owning worker
+        std::size_t lifo_streak = 0;
+    };
+
+    // Limits consecutive runs from the LIFO slot, so tasks that keep
+    // rescheduling themselves do not starve the shared queue.
+    static constexpr std::size_t max_lifo_streak = 32;
+    // Time an idle worker leaves the owner of an occupied slot to run it,
+    // before taking the task itself.
+    static constexpr std::chrono::microseconds steal_delay{50};
+
+    inline static thread_local worker_state* current_worker = nullptr;
+
+    void enque_local(worker_state& self, void_invocable f)
+    {
+        std::optional<queued_task> displaced;
+        {
+          std::lock_guard<std::mutex> slot_lock(self.slot_mutex);
+          if (self.lifo_slot)
+            displaced = std::move(self.lifo_slot);
+          self.lifo_slot.emplace(queued_task{std::move(f), trace_stamp::now()});
+        }
+
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          // incremented under the lock, so idle workers are not left waiting
+          if (displaced)
+            tasks.push_back(std::move(*displaced));
+          else
+            occupied_slots.fetch_add(1, std::memory_order_relaxed);
+        }
+        cv.notify_one();
+    }
+
+    std::optional<queued_task> take_slot(worker_state& w)
+    {
+        std::optional<queued_task> task;
+        std::lock_guard<std::mutex> slot_lock(w.slot_mutex);
+        if (w.lifo_slot)
+        {
+          task = std::move(w.lifo_slot);
+          w.lifo_slot.reset();
+          occupied_slots.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    std::optional<queued_task> steal_slot(worker_state& self)
+    {
+        for (worker_state& w : local)
+          if (&w != &self)
+            if (auto task = take_slot(w))
+              return task;
+        return std::nullopt;
+    }
+
+    void runWork(std::size_t index, std::stop_token st)
     {
+        worker_state& self = local[index];
+        current_worker = &self;
+
         while (true)
         {
+            if (self.lifo_streak < max_lifo_streak)
+            {
+              if (auto task = take_slot(self))
+              {
+                ++self.lifo_streak;
+                // slot is not part of the shared queue, depth is not known without locking
+                instr.task_started(this, task->enqueued, 0);
+                std::move(task->fn)();
+                continue;
+              }
+            }
+            // the slot may still be occupied, if the streak was exhausted
+            bool streak_exhausted = self.lifo_streak == max_lifo_streak;
+            self.lifo_streak = 0;
+
             std::unique_lock<std::mutex> lock(mutex);
-            bool has_task = cv.wait(lock, st, [this] { return !tasks.empty(); });
+            bool has_task = streak_exhausted
+                          ? !tasks.empty()
+                          : cv.wait(lock, st, [this] {
+                              return !tasks.empty() || occupied_slots.load(std::memory_order_relaxed) != 0;
+                            });
             if (st.stop_requested())
               return;
             if (!has_task)
               continue;
 
+            if (tasks.empty())
+            {
+              // only the slots of other workers are occupied
+              if (!cv.wait_for(lock, st, steal_delay, [this] { return !tasks.empty(); }))
+              {
+                if (st.stop_requested())
+                  return;
+                lock.unlock();
+                if (auto task = steal_slot(self))
+                {
+                  instr.task_started(this, task->enqueued, 0);
+                  std::move(task->fn)();
+                }
+                continue;
+              }
+            }
+
             auto task = std::move(tasks.front());
             tasks.pop_front();
+            std::size_t depth = tasks.size();
             lock.unlock();
 
-            std::move(task)();
+            instr.task_started(this, task.enqueued, depth);
+            std::move(task.fn)();
         }
     }
-    
+
     std::condition_variable_any cv;
     std::mutex mutex;
 
+    std::deque<queued_task, pool_allocator<queued_task>> tasks;
+    // number of occupied LIFO slots, that are also waited for by idle workers
+    std::atomic<std::size_t> occupied_slots{0};
+    [[no_unique_address]] pool_instrumentation instr;
+    std::vector<worker_state> local;
+    // declared last, so the workers are stopped and joined before tasks are destroyed
     std::vector<std::jthread> workers;
-    std::deque<void_invocable> tasks;
 };
 
 template<receiver_of Receiver>
 void_invocable to_void_invocable(Receiver&& recv)
 {
-   return void_invocable(std::in_place, [r = std::forward<Receiver>(recv)] () mutable {
-     try
-     {
-         std::move(r).set_value();
-     } 
-     catch (...)
-     {
-         std::move(r).set_error(std::current_exception());
-     }
+   auto alloc = get_allocator(recv);
+   return void_invocable(std::allocator_arg, alloc, std::in_place, [r = std::forward<Receiver>(recv)] () mutable {
+     set_value_or_error(std::move(r));
    });
 }
 
@@ -149,11 +340,11 @@ struct thread_pool::sender_type
    template<template<class...> class Tuple, template<class...> class Variant>
      using value_types = Variant<Tuple<>>;
    template<template<class...> class Variant>
-     using error_types = Variant<std::exception_ptr>;
+     using error_types = set_value_error_types<Variant>;
    static constexpr bool sends_done = false;
 
-   explicit sender_type(thread_pool& p) 
-     : pool(&p)
+   explicit sender_type(thread_pool& p, bool handoff = false)
+     : pool(&p), handoff(handoff)
    {}
 
    template<typename Receiver>
@@ -164,19 +355,24 @@ struct thread_pool::sender_type
       {
          void_invocable val;
          thread_pool* pool;
+         bool handoff;
 
          void start() && {
+             if (handoff)
+               return pool->enque_shared(std::move(val));
              pool->enque(std::move(val));
          }
       };
 
-      return operation_type{to_void_invocable(std::forward<Receiver>(r)), s.pool};
+      return operation_type{to_void_invocable(std::forward<Receiver>(r)), s.pool, s.handoff};
    }
 
    template<typename Receiver>
      requires receiver_of<Receiver>
    friend void submit(sender_type s, Receiver&& r)
    {
+       if (s.handoff)
+         return s.pool->enque_shared(to_void_invocable(std::forward<Receiver>(r)));
        s.pool->enque(to_void_invocable(std::forward<Receiver>(r)));
    }
 
@@ -184,22 +380,37 @@ struct thread_pool::sender_type
 
 private:
    thread_pool* pool;
+   bool handoff;
 };
 
 
 struct thread_pool::scheduler_type
 {
-   explicit scheduler_type(thread_pool& p) 
-     : pool(&p)
+   explicit scheduler_type(thread_pool& p, bool handoff = false)
+     : pool(&p), handoff(handoff)
    {}
 
    thread_pool::sender_type schedule() const
    {
-      return thread_pool::sender_type(*pool);
+      return thread_pool::sender_type(*pool, handoff);
+   }
+
+   // Scheduler of the same pool, whose tasks bypass the LIFO slot of the
+   // calling worker (see enque_shared).
+   scheduler_type handoff_scheduler() const
+   {
+      return scheduler_type(*pool, true);
+   }
+
+   // True if called from one of the workers of the pool.
+   bool on_same_worker() const
+   {
+      return current_worker && current_worker->pool == pool;
    }
 
 private:
    thread_pool* pool;
+   bool handoff;
 };
 
 inline thread_pool::scheduler_type thread_pool::scheduler()
@@ -209,5 +420,5 @@ inline thread_pool::scheduler_type thread_pool::scheduler()
    
 inline thread_pool::scheduler_type thread_pool::sender_type::scheduler() const
 {
-   return thread_pool::scheduler_type(*pool);
+   return thread_pool::scheduler_type(*pool, handoff);
 }